@@ -0,0 +1,59 @@
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A small AVX kernel, to measure what packed SIMD ops cost to
+// shadow. Each iteration does a Mul64Fx4 and Add64Fx4 on four
+// doubles, and a Mul32Fx8 and Add32Fx8 on eight floats. Passing
+// "scalar" as the second argument does the same math one lane at a
+// time, for comparison.
+#define DLANES 4
+#define FLANES 8
+
+static void vectorKernel(long iters, double* d, float* f){
+  __m256d dacc = _mm256_loadu_pd(d);
+  __m256d dscale = _mm256_set1_pd(0.999);
+  __m256d dstep = _mm256_set_pd(0.1, 0.2, 0.3, 0.4);
+  __m256 facc = _mm256_loadu_ps(f);
+  __m256 fscale = _mm256_set1_ps(0.999f);
+  __m256 fstep = _mm256_set_ps(0.1f, 0.2f, 0.3f, 0.4f,
+                               0.5f, 0.6f, 0.7f, 0.8f);
+  for (long i = 0; i < iters; ++i) {
+    dacc = _mm256_add_pd(_mm256_mul_pd(dacc, dscale), dstep);
+    facc = _mm256_add_ps(_mm256_mul_ps(facc, fscale), fstep);
+  }
+  _mm256_storeu_pd(d, dacc);
+  _mm256_storeu_ps(f, facc);
+}
+
+static void scalarKernel(long iters, double* d, float* f){
+  const double dstep[DLANES] = {0.4, 0.3, 0.2, 0.1};
+  const float fstep[FLANES] = {0.8f, 0.7f, 0.6f, 0.5f,
+                               0.4f, 0.3f, 0.2f, 0.1f};
+  for (long i = 0; i < iters; ++i) {
+    for (int j = 0; j < DLANES; ++j) {
+      d[j] = d[j] * 0.999 + dstep[j];
+    }
+    for (int j = 0; j < FLANES; ++j) {
+      f[j] = f[j] * 0.999f + fstep[j];
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  long iters = argc > 1 ? atol(argv[1]) : 1000000;
+  int scalar = argc > 2 && strcmp(argv[2], "scalar") == 0;
+  double d[DLANES] = {1.0, 2.0, 3.0, 4.0};
+  float f[FLANES] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f};
+  if (scalar) {
+    scalarKernel(iters, d, f);
+  } else {
+    vectorKernel(iters, d, f);
+  }
+  double sum = 0;
+  for (int j = 0; j < DLANES; ++j) sum += d[j];
+  for (int j = 0; j < FLANES; ++j) sum += f[j];
+  printf("%.20g\n", sum);
+  return 0;
+}
@@ -0,0 +1,35 @@
+#!/usr/bin/env python3
+
+# Runs avx-kernel under herbgrind once with packed AVX ops and once
+# doing the same math a lane at a time, and reports the time per
+# shadowed lane for each. The packed version should be cheaper per
+# lane, since a whole vector is shadowed in one helper call.
+
+import subprocess
+import sys
+import time
+
+ITERS = 100000
+# Four double lanes and eight float lanes, each doing a multiply and
+# an add, per iteration of the loops in avx-kernel.c
+LANE_OPS_PER_ITER = (4 + 8) * 2
+
+def run(prog, mode):
+    command = ["./valgrind/herbgrind-install/bin/valgrind", "--tool=herbgrind",
+               "--outfile=/dev/null", prog, str(ITERS), mode]
+    start = time.time()
+    proc = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    proc.communicate()
+    elapsed = time.time() - start
+    if proc.poll():
+        print("Command `{}` failed!".format(" ".join(command)))
+        sys.exit(1)
+    return elapsed
+
+if __name__ == "__main__":
+    prog = sys.argv[1] if len(sys.argv) > 1 else "bench/avx-kernel.c.out"
+    print("{:>8} {:>10} {:>14}".format("mode", "seconds", "ns/lane-op"))
+    for mode in ["vector", "scalar"]:
+        elapsed = run(prog, mode)
+        print("{:>8} {:>10.2f} {:>14.1f}".format(
+            mode, elapsed, elapsed * 1e9 / (ITERS * LANE_OPS_PER_ITER)))
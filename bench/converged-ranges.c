@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// A subtraction that cancels badly, first fed inputs that are
+// themselves computed, long enough that herbgrind stops merging into
+// its expression, and then fed plain loaded inputs, whose concrete
+// expressions are shallower than the symbolic expression it settled
+// on. The problematic ranges for those later runs still have to come
+// out right when the influences of the printed total get reported.
+#define COMPUTED_ITERS 1000
+#define LOADED_ITERS 200
+
+static double __attribute__ ((noinline)) cancel(double x, double y){
+  return (x + y) - x;
+}
+
+int main(int argc, char** argv) {
+  volatile double big = 1e16;
+  volatile double small = 1.0;
+  volatile double xs[LOADED_ITERS];
+  volatile double ys[LOADED_ITERS];
+  for (int i = 0; i < LOADED_ITERS; ++i) {
+    xs[i] = 3e16 + 4 * i;
+    ys[i] = 0.25 + i * 0.001;
+  }
+  double total = 0.0;
+  for (int i = 0; i < COMPUTED_ITERS; ++i) {
+    total += cancel(big * 1.5 + i, small * 0.3);
+  }
+  for (int i = 0; i < LOADED_ITERS; ++i) {
+    total += cancel(xs[i], ys[i]);
+  }
+  printf("%.20g\n", total);
+  return 0;
+}
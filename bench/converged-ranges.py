@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+
+# Runs converged-ranges under herbgrind and checks that it gets
+# through reporting the influences of the printed total, ranges and
+# all. Its exact output depends on how herbgrind rounds the error
+# numbers, so unlike test.py this only checks that the report was
+# made, not what's in it.
+
+import subprocess
+import sys
+
+def run(prog):
+    command = ["./valgrind/herbgrind-install/bin/valgrind", "--tool=herbgrind",
+               "--output-sexp", prog]
+    print("Calling `{}`...".format(" ".join(command)), end=" ")
+    proc = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    stdout, stderr = proc.communicate()
+    if proc.poll():
+        print("Command failed (status {}).".format(proc.poll()))
+        print("stderr::", "\n".join(stderr.decode('utf-8').splitlines()[-200:]),
+              sep="\n")
+        return False
+    try:
+        with open(prog + ".gh") as actual:
+            actual_text = actual.read()
+    except:
+        print("Cannot find output file {}!".format(prog + ".gh"))
+        return False
+    if "(FPCore" not in actual_text or "cancel" not in actual_text:
+        print("The subtraction in cancel wasn't reported as an influence!")
+        print("Actual::", actual_text, sep="\n")
+        return False
+    print("Influences reported.")
+    return True
+
+if __name__ == "__main__":
+    prog = sys.argv[1] if len(sys.argv) > 1 else "bench/converged-ranges.c.out"
+    if not run(prog):
+        sys.exit(1)
@@ -0,0 +1,18 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// A long chain of dependent floating point ops, like the inner loop
+// of an iterative solver. Every op's expression sits on top of the
+// previous one's, so the cost of maintaining concrete expressions
+// shows up directly in how long this takes per op.
+int main(int argc, char** argv) {
+  long iters = argc > 1 ? atol(argv[1]) : 1000000;
+  volatile double x = 0.5;
+  volatile double y = 0.25;
+  for (long i = 0; i < iters; ++i) {
+    x = x * 0.999 + y;
+    y = y * 0.5 + x * 0.001;
+  }
+  printf("%.20g\n", x + y);
+  return 0;
+}
@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+
+# Runs expr-chain under herbgrind at increasing expression depths, and
+# reports the time per shadowed op. Keeping concrete expressions alive
+# should cost about the same per op no matter how deep we let them
+# get.
+
+import subprocess
+import sys
+import time
+
+ITERS = 200000
+# Five shadowed ops per iteration of the loop in expr-chain.c
+OPS_PER_ITER = 5
+DEPTHS = [1, 2, 5, 10, 20, 40]
+
+def run(prog, depth):
+    command = ["./valgrind/herbgrind-install/bin/valgrind", "--tool=herbgrind",
+               "--max-expr-block-depth={}".format(depth),
+               "--outfile=/dev/null", prog, str(ITERS)]
+    start = time.time()
+    proc = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    proc.communicate()
+    elapsed = time.time() - start
+    if proc.poll():
+        print("Command `{}` failed!".format(" ".join(command)))
+        sys.exit(1)
+    return elapsed
+
+if __name__ == "__main__":
+    prog = sys.argv[1] if len(sys.argv) > 1 else "bench/expr-chain.c.out"
+    print("{:>6} {:>10} {:>12}".format("depth", "seconds", "ns/op"))
+    for depth in DEPTHS:
+        elapsed = run(prog, depth)
+        print("{:>6} {:>10.2f} {:>12.1f}".format(
+            depth, elapsed, elapsed * 1e9 / (ITERS * OPS_PER_ITER)))
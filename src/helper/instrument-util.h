@@ -45,6 +45,7 @@
 #define mkU128(x) IRExpr_Const(IRConst_V128(x))
 #define mkU64(x) IRExpr_Const(IRConst_U64(x))
 #define mkU32(x) IRExpr_Const(IRConst_U32(x))
+#define mkU8(x) IRExpr_Const(IRConst_U8(x))
 #define mkU1(x) IRExpr_Const(IRConst_U1(x))
 
 IRExpr* runLoad64(IRSB* sbOut, IRExpr* address);
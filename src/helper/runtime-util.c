@@ -72,6 +72,20 @@ Addr getCallAddr(void){
   return 0;
 }
 
+// Client requests coming from our replacement functions tell us the
+// return address of the call, so we don't have to walk the stack and
+// ask debuginfo about every frame. Stack traces report the caller
+// frames one byte back, inside the call instruction, so do the same
+// here to get the same addresses getCallAddr would. A zero return
+// address means the request didn't know it, so we fall back to
+// walking the stack.
+Addr callAddrFromReturnAddr(Addr returnAddr){
+  if (returnAddr == 0){
+    return getCallAddr();
+  }
+  return returnAddr - 1;
+}
+
 void printBBufFloat(BBuf* buf, double val){
   int i = 0;
   if (val != val){
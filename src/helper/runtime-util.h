@@ -34,6 +34,7 @@
 #include "bbuf.h"
 
 Addr getCallAddr(void);
+Addr callAddrFromReturnAddr(Addr returnAddr);
 void printBBufFloat(BBuf* buf, double value);
 VG_REGPARM(1) void ppFloat_wrapper(UWord value);
 void ppFloat(double value);
@@ -34,8 +34,13 @@
 #include "instrument/instrument.h"
 #include "runtime/shadowop/mathreplace.h"
 #include "runtime/shadowop/influence-op.h"
+#include "runtime/shadowop/error.h"
 #include "runtime/op-shadowstate/marks.h"
 #include "runtime/op-shadowstate/output.h"
+#include "runtime/value-shadowstate/value-shadowstate.h"
+#include "helper/runtime-util.h"
+
+#include "pub_tool_transtab.h"
 
 #include "helper/mpfr-valgrind-glue.h"
 
@@ -48,12 +53,22 @@ static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
   switch(arg[0]) {
   case VG_USERREQ__BEGIN:
     running_depth++;
+    if (running_depth == 1){
+      // Registers have been written without us watching, so any
+      // shadows left in them are stale.
+      clearShadowThreadStates();
+      discardAllTranslations();
+    }
     break;
   case VG_USERREQ__END:
     running_depth--;
+    if (running_depth == 0){
+      discardAllTranslations();
+    }
     break;
   case VG_USERREQ__PERFORM_OP:
-    performWrappedOp((OpType)arg[1], (double*)arg[2], (double*)arg[3]);
+    performWrappedOp((OpType)arg[1], (double*)arg[2], (double*)arg[3],
+                     callAddrFromReturnAddr((Addr)arg[4]));
     break;
   case VG_USERREQ__PERFORM_OPF:
     {
@@ -62,13 +77,15 @@ static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
       for (int i = 0; i < getWrappedNumArgs((OpType)arg[1]); ++i){
         double_args[i] = ((float*)arg[3])[i];
       }
-      performWrappedOp((OpType)arg[1], &double_result, double_args);
+      performWrappedOp((OpType)arg[1], &double_result, double_args,
+                       callAddrFromReturnAddr((Addr)arg[4]));
       *(float*)arg[2] = double_result;
     }
     break;
   case VG_USERREQ__PERFORM_SPECIAL_OP:
     performSpecialWrappedOp((SpecialOpType)arg[1], (double*)arg[2],
-                            (double*)arg[3], (double*)arg[4]);
+                            (double*)arg[3], (double*)arg[4],
+                            callAddrFromReturnAddr((Addr)arg[5]));
     break;
   case VG_USERREQ__MARK_IMPORTANT:
     markImportant(getMemShadow((Addr)arg[1]),
@@ -92,6 +109,30 @@ static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
   return True;
 }
 
+// Translations are instrumented differently depending on whether
+// we're in a HERBGRIND_BEGIN()/HERBGRIND_END() region, so they all
+// have to go when we enter or leave one.
+static void discardAllTranslations(void){
+  VG_(discard_translations_safely)((Addr)0x1000, ~(SizeT)0xfff,
+                                   "herbgrind region toggle");
+}
+
+// This is called when a chunk of client memory is unmapped or
+// released, so we can drop any shadows that were living there.
+static void hg_die_mem(Addr a, SizeT len){
+  clearMemShadowRange(a, len);
+}
+
+// This is called whenever a thread gets scheduled to run client
+// code, so we can swap in that thread's shadow state.
+static void hg_start_client_code(ThreadId tid, ULong blocks_dispatched){
+  switchShadowThread(tid);
+}
+// This is called when a thread is about to go away.
+static void hg_thread_exit(ThreadId tid){
+  exitShadowThread(tid);
+}
+
 // This is called after the program exits, for cleanup and such.
 static void hg_fini(Int exitcode){
   finish_instrumentation();
@@ -101,6 +142,7 @@ static void hg_fini(Int exitcode){
 // line processing.
 static void hg_post_clo_init(void){
   init_instrumentation();
+  initErrorTables();
 }
 
 // This is where we initialize everything
@@ -119,6 +161,10 @@ static void hg_pre_clo_init(void)
                                  hg_fini);
 
    VG_(needs_client_requests) (hg_handle_client_request);
+   VG_(track_die_mem_munmap)    (hg_die_mem);
+   VG_(track_die_mem_brk)       (hg_die_mem);
+   VG_(track_start_client_code) (hg_start_client_code);
+   VG_(track_pre_thread_ll_exit)(hg_thread_exit);
    VG_(needs_command_line_options)(hg_process_cmd_line_option,
                                    hg_print_usage,
                                    hg_print_debug_usage);
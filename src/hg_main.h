@@ -40,12 +40,21 @@
 // This does any initialization that needs to be done after command
 // line processing.
 static void hg_post_clo_init(void);
+// This is called when client memory goes away.
+static void hg_die_mem(Addr a, SizeT len);
+// This is called when a thread is scheduled to run client code.
+static void hg_start_client_code(ThreadId tid, ULong blocks_dispatched);
+// This is called when a thread is about to exit.
+static void hg_thread_exit(ThreadId tid);
 // This is called after the program exits, for cleanup and such.
 static void hg_fini(Int exitcode);
 // This is called after the program exits, for cleanup and such.
 // This handles client requests, the macros that client programs stick
 // in to send messages to the tool.
 static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret);
+// This throws away every translation, so that blocks get
+// re-instrumented when we start or stop running.
+static void discardAllTranslations(void);
 // This is where we initialize everything
 static void hg_pre_clo_init(void);
 
@@ -74,18 +74,24 @@ typedef enum {
       _qzz_res;                                   \
     }))
 
+// The PERFORM_OP requests are meant to be used directly inside a
+// replacement function, and pass along its return address so that
+// Herbgrind can attribute the op to the call site without walking the
+// stack.
 #define HERBGRIND_PERFORM_OP(_qzz_op, _qzz_result_addr, _qzz_args)      \
   (__extension__({unsigned long _qzz_res;                               \
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
                                  VG_USERREQ__PERFORM_OP, \
-                                 _qzz_op, _qzz_result_addr, _qzz_args, 0, 0); \
+                                 _qzz_op, _qzz_result_addr, _qzz_args, \
+                                 __builtin_return_address(0), 0);  \
       _qzz_res; \
     }))
 #define HERBGRIND_PERFORM_OPF(_qzz_op, _qzz_result_addr, _qzz_args)      \
   (__extension__({unsigned long _qzz_res;                               \
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
                                  VG_USERREQ__PERFORM_OPF, \
-                                 _qzz_op, _qzz_result_addr, _qzz_args, 0, 0); \
+                                 _qzz_op, _qzz_result_addr, _qzz_args, \
+                                 __builtin_return_address(0), 0);  \
       _qzz_res; \
     }))
 #define HERBGRIND_PERFORM_SPECIAL_OP(_qzz_op, _qzz_args, \
@@ -94,7 +100,8 @@ typedef enum {
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
                                  VG_USERREQ__PERFORM_SPECIAL_OP,        \
                                  _qzz_op, _qzz_args, \
-                                 _qzz_res1, _qzz_res2, 0);    \
+                                 _qzz_res1, _qzz_res2,               \
+                                 __builtin_return_address(0));       \
       _qzz_res; \
     }))
 
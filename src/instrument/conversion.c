@@ -245,7 +245,7 @@ void instrumentConversion(IRSB* sbOut, IROp op_code, IRExpr** argExprs,
           vals[0] = runPureCCall64(sbOut, toSingle, vals[0]);
         }
         tl_assert(shadowInputs[0]);
-        shadowOutput = runMkShadowTempValues(sbOut, dest_size, vals);
+        shadowOutput = runMkShadowTempValues(sbOut, dest_size, vals, False);
       } else {
         vals[0] = runIndexG(sbOut, inputPreexisting,
                             runArrowG(sbOut, inputPreexisting,
@@ -259,7 +259,7 @@ void instrumentConversion(IRSB* sbOut, IROp op_code, IRExpr** argExprs,
         tl_assert(shadowInputs[0]);
         shadowOutput = runMkShadowTempValuesG(sbOut,
                                               inputPreexisting, NULL,
-                                              dest_size, vals);
+                                              dest_size, vals, False);
       }
     }
     break;
@@ -42,6 +42,7 @@ ValueType tempTypes[MAX_TEMPS][MAX_TEMP_BLOCKS];
 TSTypeEntry* tsTypes[MAX_REGISTERS];
 ShadowStatus tempShadowStatus[MAX_TEMPS];
 ShadowStatus tsShadowStatus[MAX_REGISTERS];
+Bool tempBorrowsTS[MAX_TEMPS];
 
 void initTypeState(void){
   tsTypeEntries = mkStack();
@@ -50,6 +51,7 @@ void resetTypeState(void){
   VG_(memset)(tempTypes, 0, sizeof tempTypes);
   VG_(memset)(tempShadowStatus, 0, sizeof tempShadowStatus);
   VG_(memset)(tsShadowStatus, 0, sizeof tsShadowStatus);
+  VG_(memset)(tempBorrowsTS, 0, sizeof tempBorrowsTS);
   for(int i = 0; i < MAX_REGISTERS; ++i){
     while (tsTypes[i] != NULL){
       TSTypeEntry* nextEntry = tsTypes[i]->next;
@@ -1194,6 +1196,103 @@ void inferTypes(IRSB* sbIn){
   }
 }
 
+static void markTempEscapes(Bool* escapes, IRExpr* expr){
+  if (expr != NULL && expr->tag == Iex_RdTmp){
+    escapes[expr->Iex.RdTmp.tmp] = True;
+  }
+}
+static void markTSWritten(Bool* written, Int offset, Int size){
+  for(int i = offset; i < offset + size && i < MAX_REGISTERS; ++i){
+    written[i] = True;
+  }
+}
+// A temp that's read out of the thread state doesn't need its own
+// references to the values there, as long as nothing in the rest of
+// the block can overwrite those thread state locations (which would
+// disown them out from under it), and the temp itself never gets put
+// anywhere that outlives the block. Such temps are marked in
+// tempBorrowsTS, and get made without owning their values, and
+// cleaned up without disowning them.
+//
+// We figure this out in a single backwards pass, keeping track of
+// which thread state bytes get written, and which temps get put or
+// stored, later in the block.
+void inferBorrowedTemps(IRSB* sbIn){
+  static Bool tsWrittenLater[MAX_REGISTERS];
+  static Bool tempEscapesLater[MAX_TEMPS];
+  VG_(memset)(tsWrittenLater, 0, sizeof tsWrittenLater);
+  VG_(memset)(tempEscapesLater, 0, sizeof tempEscapesLater);
+  Bool tsWrittenDynamically = False;
+  for(int instrIdx = sbIn->stmts_used - 1; instrIdx >= 0; --instrIdx){
+    IRStmt* stmt = sbIn->stmts[instrIdx];
+    switch(stmt->tag){
+    case Ist_WrTmp:{
+      IRTemp dest = stmt->Ist.WrTmp.tmp;
+      IRExpr* expr = stmt->Ist.WrTmp.data;
+      if (expr->tag != Iex_Get || dest >= MAX_TEMPS ||
+          tsWrittenDynamically || tempEscapesLater[dest]){
+        break;
+      }
+      Int offset = expr->Iex.Get.offset;
+      Int size = sizeofIRType(expr->Iex.Get.ty);
+      if (offset + size > MAX_REGISTERS){
+        break;
+      }
+      Bool overwritten = False;
+      for(int i = offset; i < offset + size; ++i){
+        if (tsWrittenLater[i]){
+          overwritten = True;
+          break;
+        }
+      }
+      tempBorrowsTS[dest] = !overwritten;
+    }
+      break;
+    case Ist_Put:
+      markTSWritten(tsWrittenLater, stmt->Ist.Put.offset,
+                    sizeofIRType(typeOfIRExpr(sbIn->tyenv,
+                                              stmt->Ist.Put.data)));
+      markTempEscapes(tempEscapesLater, stmt->Ist.Put.data);
+      break;
+    case Ist_PutI:
+      tsWrittenDynamically = True;
+      markTempEscapes(tempEscapesLater, stmt->Ist.PutI.details->data);
+      break;
+    case Ist_Store:
+      markTempEscapes(tempEscapesLater, stmt->Ist.Store.data);
+      break;
+    case Ist_StoreG:
+      markTempEscapes(tempEscapesLater, stmt->Ist.StoreG.details->data);
+      break;
+    case Ist_CAS:
+      markTempEscapes(tempEscapesLater, stmt->Ist.CAS.details->dataLo);
+      markTempEscapes(tempEscapesLater, stmt->Ist.CAS.details->dataHi);
+      break;
+    case Ist_LLSC:
+      markTempEscapes(tempEscapesLater, stmt->Ist.LLSC.storedata);
+      break;
+    case Ist_Dirty:{
+      IRDirty* details = stmt->Ist.Dirty.details;
+      for(int i = 0; details->args[i] != NULL; ++i){
+        markTempEscapes(tempEscapesLater, details->args[i]);
+      }
+      for(int i = 0; i < details->nFxState; ++i){
+        if (details->fxState[i].fx == Ifx_Read){
+          continue;
+        }
+        Int offset = details->fxState[i].offset;
+        Int span = details->fxState[i].size +
+          details->fxState[i].nRepeats * details->fxState[i].repeatLen;
+        markTSWritten(tsWrittenLater, offset, span);
+      }
+    }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
 void typeJoins(ValueType* types1, ValueType* types2,
                FloatBlocks numTypes, ValueType* out){
   for(int i = 0; i < INT(numTypes); ++i){
@@ -65,6 +65,7 @@ typedef struct {
 #define FB(x) (FloatBlocks){x}
 
 extern ShadowStatus tempShadowStatus[MAX_TEMPS];
+extern Bool tempBorrowsTS[MAX_TEMPS];
 extern ShadowStatus tsShadowStatus[MAX_REGISTERS];
 
 // Meet and join operations for the type lattice
@@ -84,6 +85,7 @@ void resetTypeState(void);
 void cleanupTypeState(void);
 void addClearMemTypes(void);
 void inferTypes(IRSB* sbIn);
+void inferBorrowedTemps(IRSB* sbIn);
 
 ValueType opArgPrecision(IROp op_code);
 ValueType opBlockArgPrecision(IROp op_code, int blockIdx);
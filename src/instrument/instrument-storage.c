@@ -330,7 +330,8 @@ void instrumentGet(IRSB* sbOut, IRTemp dest,
     if (PRINT_VALUE_MOVES){
       addPrint2(" from TS(%d)\n", mkU64(tsSrc));
     }
-    IRExpr* temp = runMkShadowTempValues(sbOut, src_size, vals);
+    IRExpr* temp = runMkShadowTempValues(sbOut, src_size, vals,
+                                         tempBorrowsTS[dest]);
     addStoreTemp(sbOut, temp, dest);
   }
     break;
@@ -343,7 +344,8 @@ void instrumentGet(IRSB* sbOut, IRTemp dest,
       IRExpr* loadedVal = runGetTSVal(sbOut, tsSrc, instrIdx);
       IRExpr* loadedValNonNull = runNonZeroCheck64(sbOut, loadedVal);
       IRExpr* temp = runMkShadowTempValuesG(sbOut, loadedValNonNull, NULL,
-                                            src_size, &loadedVal);
+                                            src_size, &loadedVal,
+                                            tempBorrowsTS[dest]);
       addStoreTemp(sbOut, temp, dest);
     } else {
       IRExpr* loadedVals[MAX_TEMP_BLOCKS];
@@ -372,7 +374,8 @@ void instrumentGet(IRSB* sbOut, IRTemp dest,
       IRExpr* someValNonNull = runUnop(sbOut, Iop_32to1, someValNonNull32);
       IRExpr* temp = runMkShadowTempValuesG(sbOut,
                                             someValNonNull, someValNonNull32,
-                                            src_size, loadedVals);
+                                            src_size, loadedVals,
+                                            tempBorrowsTS[dest]);
       addStoreTemp(sbOut, temp, dest);
     }
   }
@@ -408,7 +411,7 @@ void instrumentGetI(IRSB* sbOut, IRTemp dest,
                            runNonZeroCheck64(sbOut, loadedVals[i]));
   }
   IRExpr* temp = runMkShadowTempValuesG(sbOut, someValNonNull, NULL,
-                                        src_size, loadedVals);
+                                        src_size, loadedVals, False);
   addStoreTemp(sbOut, temp, dest);
 }
 void instrumentLoad(IRSB* sbOut, IRTemp dest,
@@ -514,33 +517,55 @@ void finishInstrumentingBlock(IRSB* sbOut){
 void addBlockCleanupG(IRSB* sbOut, IRExpr* guard){
   cleanupBlockOwnership(sbOut, guard);
 }
+// Bump a temp off the temp arena, or, if this block has used it up,
+// call out for one from the freelists. Arena slots get reused from
+// block to block, so the borrowed mask always has to be stored, even
+// when it's zero.
+static IRExpr* runMkShadowTempG(IRSB* sbOut, IRExpr* guard,
+                                FloatBlocks num_blocks,
+                                UWord borrowed){
+  IRExpr* arenaNext = runLoad64C(sbOut, &tempArenaNext);
+  IRExpr* arenaHasRoom =
+    runBinop(sbOut, Iop_CmpLT64U, arenaNext,
+             mkU64((uintptr_t)(tempArena + TEMP_ARENA_SLOTS)));
+  IRExpr* shouldBump = runAnd(sbOut, guard, arenaHasRoom);
+  addStoreGC(sbOut, shouldBump,
+             runBinop(sbOut, Iop_Add64, arenaNext,
+                      mkU64(sizeof(ArenaTempSlot))),
+             &tempArenaNext);
+  addStoreArrowG(sbOut, shouldBump, arenaNext, ShadowTemp, num_blocks,
+                 mkU32(INT(num_blocks)));
+  IRExpr* shouldCallOut =
+    runAnd(sbOut, guard, runUnop(sbOut, Iop_Not1, arenaHasRoom));
+  IRExpr* offArenaTemp =
+    runDirtyG_1_1(sbOut, shouldCallOut, mkShadowTempOffArena,
+                  mkU64(INT(num_blocks)));
+  IRExpr* temp = runITE(sbOut, arenaHasRoom, arenaNext, offArenaTemp);
+  addStoreArrowG(sbOut, guard, temp, ShadowTemp, borrowed,
+                 mkU64(borrowed));
+  return temp;
+}
 IRExpr* runMkShadowTempValuesG(IRSB* sbOut, IRExpr* guard1,
                                IRExpr* guard32,
                                FloatBlocks num_blocks,
-                               IRExpr** values){
+                               IRExpr** values,
+                               Bool borrow){
   if (guard32 == NULL){
     guard32 = runUnop(sbOut, Iop_1Uto32, guard1);
   }
-  IRExpr* stackEmpty1 = runStackEmpty(sbOut, freedTemps[INT(num_blocks)-1]);
-  IRExpr* stackEmpty32 = runUnop(sbOut, Iop_1Uto32, stackEmpty1);
-  IRExpr* shouldMake32 = runBinop(sbOut, Iop_And32, stackEmpty32, guard32);
-  IRExpr* shouldMake1 = runUnop(sbOut, Iop_32to1, shouldMake32);
-  IRExpr* freshTemp = runDirtyG_1_1(sbOut, shouldMake1, newShadowTemp,
-                                    mkU64(INT(num_blocks)));
-  IRExpr* shouldPop32 = runBinop(sbOut, Iop_And32, guard32,
-                                 runUnop(sbOut, Iop_Not32, stackEmpty32));
-  IRExpr* shouldPop1 = runUnop(sbOut, Iop_32to1, shouldPop32);
-  IRExpr* poppedTemp = runStackPopG(sbOut, shouldPop1,
-                                    freedTemps[INT(num_blocks)-1]);
-  IRExpr* temp = runITE(sbOut, stackEmpty1, freshTemp, poppedTemp);
+  IRExpr* temp =
+    runMkShadowTempG(sbOut, guard1, num_blocks,
+                     borrow ? (1UL << INT(num_blocks)) - 1 : 0);
   IRExpr* tempValues = runArrowG(sbOut, guard1, temp, ShadowTemp, values);
   for(int i = 0; i < INT(num_blocks); ++i){
-    IRExpr* valueNonNull32 = runUnop(sbOut, Iop_1Uto32,
-                                     runNonZeroCheck64(sbOut, values[i]));
-    IRExpr* shouldOwn1 = runUnop(sbOut, Iop_32to1,
-                                 runBinop(sbOut, Iop_And32,
-                                          valueNonNull32, guard32));
-    addSVOwnNonNullG(sbOut, shouldOwn1, values[i]);
+    if (!borrow){
+      IRExpr* valueNonNull32 = runUnop(sbOut, Iop_1Uto32,
+                                       runNonZeroCheck64(sbOut, values[i]));
+      IRExpr* shouldOwn1 = runUnop(sbOut, Iop_32to1,
+                                   runBinop(sbOut, Iop_And32,
+                                            valueNonNull32, guard32));
+      addSVOwnNonNullG(sbOut, shouldOwn1, values[i]);
+    }
     addStoreIndexG(sbOut, guard1, tempValues, ShadowValue*, i, values[i]);
   }
   IRExpr* result = runITE(sbOut, guard1, temp, mkU64(0));
@@ -554,17 +579,15 @@ IRExpr* runMkShadowTempValuesG(IRSB* sbOut, IRExpr* guard1,
   return result;
 }
 IRExpr* runMkShadowTempValues(IRSB* sbOut, FloatBlocks num_blocks,
-                              IRExpr** values){
-  IRExpr* stackEmpty = runStackEmpty(sbOut, freedTemps[INT(num_blocks)-1]);
-  IRExpr* freshTemp = runDirtyG_1_1(sbOut, stackEmpty, newShadowTemp,
-                                    mkU64(INT(num_blocks)));
-  IRExpr* poppedTemp = runStackPopG(sbOut,
-                                    runUnop(sbOut, Iop_Not1, stackEmpty),
-                                    freedTemps[INT(num_blocks)-1]);
-  IRExpr* temp = runITE(sbOut, stackEmpty, freshTemp, poppedTemp);
+                              IRExpr** values, Bool borrow){
+  IRExpr* temp =
+    runMkShadowTempG(sbOut, mkU1(True), num_blocks,
+                     borrow ? (1UL << INT(num_blocks)) - 1 : 0);
   IRExpr* tempValues = runArrow(sbOut, temp, ShadowTemp, values);
   for(int i = 0; i < INT(num_blocks); ++i){
-    addSVOwn(sbOut, values[i]);
+    if (!borrow){
+      addSVOwn(sbOut, values[i]);
+    }
     addStoreIndex(sbOut, tempValues, ShadowValue*, i, values[i]);
   }
   if (PRINT_TEMP_MOVES){
@@ -664,8 +687,11 @@ IRExpr* runLoadTemp(IRSB* sbOut, int idx){
 }
 IRExpr* runGetTSVal(IRSB* sbOut, Int tsSrc, int instrIdx){
   tl_assert(tsAddrCanBeShadowed(tsSrc, instrIdx));
-  IRExpr* val = runLoad64C(sbOut,
-                           &(shadowThreadState[VG_(get_running_tid)()][tsSrc]));
+  IRExpr* val = runLoad64(sbOut,
+                          runBinop(sbOut,
+                                   Iop_Add64,
+                                   runLoad64C(sbOut, &shadowThreadState),
+                                   mkU64(tsSrc * sizeof(ShadowValue*))));
   /* if (PRINT_VALUE_MOVES){ */
   /*   if (tsHasStaticShadow(tsSrc, instrIdx)){ */
   /*     addPrint3("Getting val %p from TS(%d) -> ", val, mkU64(tsSrc)); */
@@ -680,8 +706,7 @@ IRExpr* runGetTSValDynamic(IRSB* sbOut, IRExpr* tsSrc){
   return runLoad64(sbOut,
                    runBinop(sbOut,
                             Iop_Add64,
-                            mkU64((uintptr_t)shadowThreadState
-                                  [VG_(get_running_tid)()]),
+                            runLoad64C(sbOut, &shadowThreadState),
                             tsSrc));
 }
 void addSetTSValNonNull(IRSB* sbOut, Int tsDest,
@@ -720,9 +745,12 @@ void addSetTSVal(IRSB* sbOut, Int tsDest, IRExpr* newVal, int instrIdx){
                "addSetTSVal: Setting thread state TS(%d) to %p\n",
                mkU64(tsDest), newVal);
   }
-  addStoreC(sbOut,
-            newVal,
-            &(shadowThreadState[VG_(get_running_tid)()][tsDest]));
+  addStore(sbOut,
+           newVal,
+           runBinop(sbOut,
+                    Iop_Add64,
+                    runLoad64C(sbOut, &shadowThreadState),
+                    mkU64(tsDest * sizeof(ShadowValue*))));
 }
 void addSetTSValDynamic(IRSB* sbOut, IRExpr* tsDest, IRExpr* newVal, int instrIdx){
   if (PRINT_VALUE_MOVES){
@@ -737,8 +765,7 @@ void addSetTSValDynamic(IRSB* sbOut, IRExpr* tsDest, IRExpr* newVal, int instrId
   addStore(sbOut, newVal,
            runBinop(sbOut,
                     Iop_Add64,
-                    mkU64((uintptr_t)shadowThreadState
-                          [VG_(get_running_tid)()]),
+                    runLoad64C(sbOut, &shadowThreadState),
                     runBinop(sbOut,
                              Iop_Mul64,
                              tsDest,
@@ -773,64 +800,68 @@ void addStoreTempUnknown(IRSB* sbOut, IRExpr* shadow_temp_maybe,
                          int idx){
   addStoreTemp(sbOut, shadow_temp_maybe, idx);
 }
+// Produces the address of the primary map entry that would point to
+// the shadow page for memAddr.
 IRExpr* getBucketAddr(IRSB* sbOut, IRExpr* memAddr){
-  IRExpr* bucket = runMod(sbOut, memAddr, mkU32(LARGE_PRIME));
+  IRExpr* primaryIdx =
+    runBinop(sbOut, Iop_And64,
+             runBinop(sbOut, Iop_Shr64, memAddr, mkU8(SM_PAGE_BITS)),
+             mkU64(SM_PRIMARY_MASK));
   return runBinop(sbOut, Iop_Add64,
-                  mkU64((uintptr_t)shadowMemTable),
-                  runBinop(sbOut, Iop_Mul64,
-                           bucket,
-                           mkU64(sizeof(TableValueEntry*))));
+                  mkU64((uintptr_t)shadowMemPrimary),
+                  runBinop(sbOut, Iop_Shl64, primaryIdx,
+                           mkU8(3)));
 }
 
-QuickBucketResult quickGetBucket(IRSB* sbOut, IRExpr* memAddr){
-  QuickBucketResult result;
-  IRExpr* bucketEntry =
-    runLoad64(sbOut, getBucketAddr(sbOut, memAddr));
-  IRExpr* entryExists =
-    runNonZeroCheck64(sbOut, bucketEntry);
-  IRExpr* entryAddr =
-    runArrowG(sbOut, entryExists, bucketEntry,
-              TableValueEntry, addr);
-  IRExpr* entryNext =
-    runArrowG(sbOut, entryExists, bucketEntry,
-              TableValueEntry, next);
-  IRExpr* addrMatches =
-    runBinop(sbOut, Iop_CmpEQ64, entryAddr, memAddr);
-  IRExpr* moreChain = runNonZeroCheck64(sbOut, entryNext);
-  result.entry =
-    runArrowG(sbOut, addrMatches, bucketEntry, TableValueEntry, val);
-  result.stillSearching32 =
-    runBinop(sbOut, Iop_And32,
-             runUnop(sbOut, Iop_1Uto32, moreChain),
-             runUnop(sbOut, Iop_Not32,
-                     runUnop(sbOut, Iop_1Uto32, addrMatches)));
-  return result;
-}
+// Look up the shadow for memAddr inline, as long as it's word aligned
+// and in the first page hanging off its primary map entry. If the
+// primary entry is empty, there's definitely no shadow; if there's a
+// page there but it's for a different part of memory, or the address
+// is misaligned, stillSearching32 will be set, and the caller has to
+// go to C to find it.
 QuickBucketResult quickGetBucketG(IRSB* sbOut, IRExpr* guard,
                                   IRExpr* memAddr){
   QuickBucketResult result;
-  IRExpr* bucketEntry =
+  IRExpr* page =
     runLoadG64(sbOut, getBucketAddr(sbOut, memAddr), guard);
-  IRExpr* entryExists = runNonZeroCheck64(sbOut, bucketEntry);
-  IRExpr* shouldDoAnything = runAnd(sbOut, entryExists, guard);
-  IRExpr* entryAddr =
-    runArrowG(sbOut, shouldDoAnything, bucketEntry,
-              TableValueEntry, addr);
-  IRExpr* entryNext =
-    runArrowG(sbOut, shouldDoAnything, bucketEntry,
-              TableValueEntry, next);
-  IRExpr* addrMatches =
-    runBinop(sbOut, Iop_CmpEQ64, entryAddr, memAddr);
-  IRExpr* moreChain = runNonZeroCheck64(sbOut, entryNext);
-  result.entry =
-    runArrowG(sbOut, addrMatches, bucketEntry, TableValueEntry, val);
+  IRExpr* pageExists = runNonZeroCheck64(sbOut, page);
+  IRExpr* pageBase =
+    runArrowG(sbOut, pageExists, page, ShadowMemPage, base);
+  IRExpr* misaligned =
+    runNonZeroCheck64(sbOut,
+                      runBinop(sbOut, Iop_And64, memAddr,
+                               mkU64(SM_MISALIGNMENT_MASK)));
+  IRExpr* baseMatches =
+    runAnd(sbOut,
+           runAnd(sbOut, pageExists,
+                  runUnop(sbOut, Iop_Not1, misaligned)),
+           runBinop(sbOut, Iop_CmpEQ64, pageBase,
+                    runBinop(sbOut, Iop_And64, memAddr,
+                             mkU64(~SM_PAGE_MASK))));
+  IRExpr* slotOffset =
+    runBinop(sbOut, Iop_Shl64,
+             runBinop(sbOut, Iop_Shr64,
+                      runBinop(sbOut, Iop_And64, memAddr,
+                               mkU64(SM_PAGE_MASK)),
+                      mkU8(SM_SLOT_BITS)),
+             mkU8(3));
+  IRExpr* slotAddr =
+    runBinop(sbOut, Iop_Add64,
+             runArrowAddr(sbOut, page, ShadowMemPage, vals),
+             slotOffset);
+  result.entry = runLoadG64(sbOut, slotAddr, baseMatches);
   result.stillSearching32 =
-    runBinop(sbOut, Iop_And32,
-             runUnop(sbOut, Iop_1Uto32, moreChain),
-             runUnop(sbOut, Iop_Not32,
-                     runUnop(sbOut, Iop_1Uto32, addrMatches)));
+    runBinop(sbOut, Iop_Or32,
+             runBinop(sbOut, Iop_And32,
+                      runUnop(sbOut, Iop_1Uto32, pageExists),
+                      runUnop(sbOut, Iop_Not32,
+                              runUnop(sbOut, Iop_1Uto32, baseMatches))),
+             runUnop(sbOut, Iop_1Uto32, misaligned));
   return result;
 }
+QuickBucketResult quickGetBucket(IRSB* sbOut, IRExpr* memAddr){
+  return quickGetBucketG(sbOut, mkU1(True), memAddr);
+}
 IRExpr* runGetMemUnknownG(IRSB* sbOut, IRExpr* guard,
                           FloatBlocks size, IRExpr* memSrc){
   QuickBucketResult qresults[MAX_TEMP_BLOCKS];
@@ -898,6 +929,12 @@ IRExpr* runGetMemUnknown(IRSB* sbOut, FloatBlocks size, IRExpr* memSrc){
                 runGetMemG(sbOut, goToC, size, memSrc),
                 mkU64(0));
 }
+// The shadow memory helpers below walk the primary map, whatever
+// pages hang off it, and the misaligned shadow table, none of which
+// is guest memory or has a fixed extent to declare, so they don't
+// claim any memory effects. That doesn't let the inline lookups
+// above get reordered around them: VEX never carries a load across a
+// dirty call.
 IRExpr* runGetMemG(IRSB* sbOut, IRExpr* guard, FloatBlocks size, IRExpr* memSrc){
   IRTemp result = newIRTemp(sbOut->tyenv, Ity_I64);
   IRDirty* loadDirty;
@@ -907,9 +944,7 @@ IRExpr* runGetMemG(IRSB* sbOut, IRExpr* guard, FloatBlocks size, IRExpr* memSrc)
                       VG_(fnptr_to_fnentry)(dynamicLoad),
                       mkIRExprVec_2(memSrc, mkU64(INT(size))));
   loadDirty->guard = guard;
-  loadDirty->mFx = Ifx_Read;
-  loadDirty->mAddr = mkU64((uintptr_t)shadowMemTable);
-  loadDirty->mSize = sizeof(TableValueEntry) * LARGE_PRIME;
+  loadDirty->mFx = Ifx_None;
   addStmtToIRSB(sbOut, IRStmt_Dirty(loadDirty));
   return runITE(sbOut, guard, IRExpr_RdTmp(result), mkU64(0));
 }
@@ -920,9 +955,7 @@ IRExpr* runGetMem(IRSB* sbOut, FloatBlocks size, IRExpr* memSrc){
                       2, "dynamicLoad",
                       VG_(fnptr_to_fnentry)(dynamicLoad),
                       mkIRExprVec_2(memSrc, mkU64(INT(size))));
-  loadDirty->mFx = Ifx_Read;
-  loadDirty->mAddr = mkU64((uintptr_t)shadowMemTable);
-  loadDirty->mSize = sizeof(TableValueEntry) * LARGE_PRIME;
+  loadDirty->mFx = Ifx_None;
   addStmtToIRSB(sbOut, IRStmt_Dirty(loadDirty));
   return IRExpr_RdTmp(result);
 }
@@ -934,16 +967,13 @@ void addClearMemG(IRSB* sbOut, IRExpr* guard, FloatBlocks size, IRExpr* memDest)
   for(int i = 0; i < INT(size); ++i){
     IRExpr* valDest = runBinop(sbOut, Iop_Add64, memDest,
                                mkU64(i * sizeof(float)));
-    IRExpr* destBucket = runMod(sbOut, valDest, mkU32(LARGE_PRIME));
-    IRExpr* destBucketAddr =
-      runBinop(sbOut, Iop_Add64,
-               mkU64((uintptr_t)shadowMemTable),
-               runBinop(sbOut, Iop_Mul64,
-                        destBucket,
-                        mkU64(sizeof(TableValueEntry*))));
-    IRExpr* memEntry = runLoad64(sbOut, destBucketAddr);
-    hasExistingShadow = runOr(sbOut, hasExistingShadow,
-                              runNonZeroCheck64(sbOut, memEntry));
+    QuickBucketResult qresult = quickGetBucket(sbOut, valDest);
+    hasExistingShadow =
+      runOr(sbOut, hasExistingShadow,
+            runOr(sbOut,
+                  runNonZeroCheck64(sbOut, qresult.entry),
+                  runUnop(sbOut, Iop_32to1,
+                          qresult.stillSearching32)));
   }
   addSetMemG(sbOut,
              runAnd(sbOut, hasExistingShadow, guard),
@@ -986,9 +1016,7 @@ void addSetMemG(IRSB* sbOut, IRExpr* guard, FloatBlocks size,
                       VG_(fnptr_to_fnentry)(setMemShadowTemp),
                       mkIRExprVec_3(memDest, mkU64(INT(size)), newTemp));
   storeDirty->guard = guard;
-  storeDirty->mFx = Ifx_Modify;
-  storeDirty->mAddr = mkU64((uintptr_t)shadowMemTable);
-  storeDirty->mSize = sizeof(TableValueEntry) * LARGE_PRIME;
+  storeDirty->mFx = Ifx_None;
   addStmtToIRSB(sbOut, IRStmt_Dirty(storeDirty));
 }
 IRExpr* toDoubleBytes(IRSB* sbOut, IRExpr* floatExpr){
@@ -78,11 +78,11 @@ void finishInstrumentingBlock(IRSB* sbOut);
 void addBlockCleanupG(IRSB* sbOut, IRExpr* guard);
 
 IRExpr* runMkShadowTempValues(IRSB* sbOut, FloatBlocks num_blocks,
-                              IRExpr** values);
+                              IRExpr** values, Bool borrow);
 IRExpr* runMkShadowTempValuesG(IRSB* sbOut,
                                IRExpr* guard, IRExpr* guard32,
                                FloatBlocks num_blocks,
-                               IRExpr** values);
+                               IRExpr** values, Bool borrow);
 IRExpr* runMkShadowVal(IRSB* sbOut, ValueType type, IRExpr* valExpr);
 IRExpr* runMkShadowValG(IRSB* sbOut, IRExpr* guard,
                         ValueType type, IRExpr* valExpr);
@@ -32,6 +32,7 @@
 
 #include "instrument-storage.h"
 #include "instrument-op.h"
+#include "semantic-op.h"
 
 // Pull in this header file so that we can call the valgrind version
 // of printf.
@@ -39,10 +40,47 @@
 #include "pub_tool_libcassert.h"
 #include "pub_tool_mallocfree.h"
 
+// Ijk_InvalICache exits read the range of code to throw away from
+// the guest's CMSTART and CMLEN registers. Every guest has those, but
+// VexGuestLayout doesn't carry their offsets, so get them from the
+// guest state of whichever architecture we're being built for.
+#if defined(VGA_amd64)
+#include "libvex_guest_amd64.h"
+typedef VexGuestAMD64State GuestState;
+#elif defined(VGA_x86)
+#include "libvex_guest_x86.h"
+typedef VexGuestX86State GuestState;
+#elif defined(VGA_arm64)
+#include "libvex_guest_arm64.h"
+typedef VexGuestARM64State GuestState;
+#elif defined(VGA_arm)
+#include "libvex_guest_arm.h"
+typedef VexGuestARMState GuestState;
+#elif defined(VGA_ppc64be) || defined(VGA_ppc64le)
+#include "libvex_guest_ppc64.h"
+typedef VexGuestPPC64State GuestState;
+#elif defined(VGA_ppc32)
+#include "libvex_guest_ppc32.h"
+typedef VexGuestPPC32State GuestState;
+#elif defined(VGA_s390x)
+#include "libvex_guest_s390x.h"
+typedef VexGuestS390XState GuestState;
+#elif defined(VGA_mips64)
+#include "libvex_guest_mips64.h"
+typedef VexGuestMIPS64State GuestState;
+#elif defined(VGA_mips32)
+#include "libvex_guest_mips32.h"
+typedef VexGuestMIPS32State GuestState;
+#else
+#error "Unknown guest architecture"
+#endif
+
 #include "../runtime/value-shadowstate/shadowval.h"
 #include "../runtime/value-shadowstate/value-shadowstate.h"
+#include "../runtime/shadowop/shadowop.h"
 
 #include "../helper/instrument-util.h"
+#include "../helper/ir-info.h"
 #include "../helper/debug.h"
 #include "intercept-block.h"
 
@@ -60,7 +98,36 @@ IRSB* hg_instrument (VgCallbackClosure* closure,
     VG_(printf)("Instrumenting block at %p:\n", (void*)closure->readdr);
     printSuperBlock(sbIn);
   }
+  // Outside of a HERBGRIND_BEGIN()/HERBGRIND_END() region we don't
+  // shadow anything; hg_main throws away every translation when the
+  // region starts or stops, so this gets revisited then. Nothing
+  // makes new shadows out here, so stores only have to clear the
+  // ones they overwrite until there are none left, at which point
+  // the block gets retranslated without the clears.
+  if (!RUNNING){
+    if (liveShadowValues == 0){
+      addBareBlock(sbOut, sbIn, False);
+    } else {
+      addShadowsLiveCheck(sbOut, closure, layout, vge, False);
+      addBareBlock(sbOut, sbIn, True);
+    }
+    return sbOut;
+  }
+  Bool floatFree = !blockDoesFloatMath(sbIn);
+  if (floatFree && liveShadowValues == 0){
+    addShadowsLiveCheck(sbOut, closure, layout, vge, True);
+    addBareBlock(sbOut, sbIn, False);
+    if (PRINT_OUT_BLOCKS){
+      VG_(printf)("Printing out bare block:\n");
+      printSuperBlock(sbOut);
+    }
+    return sbOut;
+  }
+  if (floatFree){
+    addShadowsLiveCheck(sbOut, closure, layout, vge, False);
+  }
   inferTypes(sbIn);
+  inferBorrowedTemps(sbIn);
   if (PRINT_RUN_BLOCKS){
     char* blockMessage = VG_(perm_malloc)(35, 1);
     VG_(snprintf)(blockMessage, 35,
@@ -70,6 +137,18 @@ IRSB* hg_instrument (VgCallbackClosure* closure,
   IRExpr* blockStateDirtyExpr = runLoad64C(sbOut, &blockStateDirty);
   addAssertEQ(sbOut, "Uncleaned block!\n", blockStateDirtyExpr, mkU64(0));
   addStoreC(sbOut, mkU64(1), &blockStateDirty);
+  if (SAMPLING){
+    // Shadowing only turns on or off at block boundaries, so every op
+    // in a block sees the same decision.
+    IRExpr* countdown =
+      runBinop(sbOut, Iop_Sub64,
+               runLoad64C(sbOut, &sampleCountdown), mkU64(1));
+    addStoreC(sbOut, countdown, &sampleCountdown);
+    addStmtToIRSB(sbOut,
+                  mkDirtyG_0_N(0, "endSampleBurst", endSampleBurst,
+                               mkIRExprVec_0(),
+                               runZeroCheck64(sbOut, countdown)));
+  }
 
   Addr curAddr = 0;
   Addr prevAddr = -1;
@@ -85,6 +164,7 @@ IRSB* hg_instrument (VgCallbackClosure* closure,
     if (print_run_stmts){
       addPrint2("Running statement %d\n", mkU64(i));
     }
+    flushShadowProgramBefore(sbOut, stmt);
     if (curAddr){
       preInstrumentStatement(sbOut, stmt, curAddr, prevAddr);
     }
@@ -97,6 +177,7 @@ IRSB* hg_instrument (VgCallbackClosure* closure,
       addPrint2("Finished running statement %d\n", mkU64(i));
     }
   }
+  flushShadowProgram(sbOut);
   finishInstrumentingBlock(sbOut);
   if (PRINT_BLOCK_BOUNDRIES){
     addPrint("\n+++++\n");
@@ -108,6 +189,115 @@ IRSB* hg_instrument (VgCallbackClosure* closure,
   return sbOut;
 }
 
+// A block that doesn't do any floating point math can't make new
+// shadow values, only move existing ones around. So as long as there
+// are no shadow values anywhere, running it uninstrumented is
+// equivalent to running it instrumented.
+Bool blockDoesFloatMath(IRSB* sbIn){
+  for(int i = 0; i < sbIn->stmts_used; ++i){
+    IRStmt* stmt = sbIn->stmts[i];
+    if (stmt->tag != Ist_WrTmp){
+      continue;
+    }
+    IRExpr* expr = stmt->Ist.WrTmp.data;
+    IROp op_code;
+    switch(expr->tag){
+    case Iex_Unop:
+      op_code = expr->Iex.Unop.op;
+      break;
+    case Iex_Binop:
+      op_code = expr->Iex.Binop.op;
+      break;
+    case Iex_Triop:
+      op_code = expr->Iex.Triop.details->op;
+      break;
+    case Iex_Qop:
+      op_code = expr->Iex.Qop.details->op;
+      break;
+    default:
+      continue;
+    }
+    if (isFloatOp(op_code) || isSpecialOp(op_code) ||
+        isExitFloatOp(op_code)){
+      return True;
+    }
+  }
+  return False;
+}
+
+// Blocks that blockDoesFloatMath says are float free get translated
+// bare while there are no shadow values, and instrumented otherwise,
+// so they start by checking that the translation they're in still
+// fits. If it doesn't, because shadows have shown up since a bare
+// translation was made (isBare), or have all died since one that
+// deals with them was, the block exits with Ijk_InvalICache over its
+// own code. That makes Valgrind throw this translation away and come
+// back to hg_instrument for the other kind.
+void addShadowsLiveCheck(IRSB* sbOut,
+                         VgCallbackClosure* closure,
+                         const VexGuestLayout* layout,
+                         const VexGuestExtents* vge,
+                         Bool isBare){
+  IRExpr* liveCount = runLoad64C(sbOut, &liveShadowValues);
+  IRExpr* wrongTranslation =
+    isBare ? runNonZeroCheck64(sbOut, liveCount) :
+    runZeroCheck64(sbOut, liveCount);
+  Bool wordIs64 = layout->sizeof_IP == 8;
+  addStmtToIRSB(sbOut,
+                IRStmt_Put(offsetof(GuestState, guest_CMSTART),
+                           wordIs64 ? mkU64(vge->base[0]) :
+                           mkU32(vge->base[0])));
+  addStmtToIRSB(sbOut,
+                IRStmt_Put(offsetof(GuestState, guest_CMLEN),
+                           wordIs64 ? mkU64(vge->len[0]) :
+                           mkU32(vge->len[0])));
+  addStmtToIRSB(sbOut,
+                IRStmt_Exit(wrongTranslation, Ijk_InvalICache,
+                            wordIs64 ? IRConst_U64(closure->nraddr) :
+                            IRConst_U32(closure->nraddr),
+                            layout->offset_IP));
+}
+
+// Copy a block over without shadowing it. If clearStores is set, any
+// shadows the block's stores overwrite are dropped, so that they
+// don't come back to life stale when shadowing resumes.
+void addBareBlock(IRSB* sbOut, IRSB* sbIn, Bool clearStores){
+  Addr prevAddr = -1;
+  Addr curAddr = 0;
+  for(int i = 0; i < sbIn->stmts_used; ++i){
+    IRStmt* stmt = sbIn->stmts[i];
+    if (stmt->tag == Ist_IMark){
+      prevAddr = curAddr;
+      curAddr = stmt->Ist.IMark.addr;
+    }
+    // We still want to catch calls to printf, so that they print
+    // high-precision values.
+    if (curAddr && stmt->tag == Ist_AbiHint &&
+        stmt->Ist.AbiHint.nia->tag == Iex_Const &&
+        stmt->Ist.AbiHint.nia->Iex.Const.con->tag == Ico_U64){
+      maybeInterceptBlock(sbOut,
+                          (void*)(uintptr_t)stmt->Ist.AbiHint.nia->Iex.Const.con->Ico.U64,
+                          (void*)prevAddr);
+    }
+    addStmtToIRSB(sbOut, stmt);
+    if (!clearStores){
+      continue;
+    }
+    if (stmt->tag == Ist_Store){
+      FloatBlocks size = exprSize(sbOut->tyenv, stmt->Ist.Store.data);
+      if (INT(size) > 0){
+        addClearMem(sbOut, size, stmt->Ist.Store.addr);
+      }
+    } else if (stmt->tag == Ist_StoreG){
+      IRStoreG* details = stmt->Ist.StoreG.details;
+      FloatBlocks size = exprSize(sbOut->tyenv, details->data);
+      if (INT(size) > 0){
+        addClearMemG(sbOut, details->guard, size, details->addr);
+      }
+    }
+  }
+}
+
 void init_instrumentation(void){
   initInstrumentationState();
 }
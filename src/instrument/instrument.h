@@ -36,6 +36,14 @@ IRSB* hg_instrument(VgCallbackClosure* closure,
                     const VexArchInfo* archinfo_host,
                     IRType gWordTy, IRType hWordTy);
 
+Bool blockDoesFloatMath(IRSB* sbIn);
+void addShadowsLiveCheck(IRSB* sbOut,
+                         VgCallbackClosure* closure,
+                         const VexGuestLayout* layout,
+                         const VexGuestExtents* vge,
+                         Bool isBare);
+void addBareBlock(IRSB* sbOut, IRSB* sbIn, Bool clearStores);
+
 void init_instrumentation(void);
 
 void finish_instrumentation(void);
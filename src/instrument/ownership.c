@@ -43,6 +43,7 @@ void initOwnership(void){
 }
 void cleanupBlockOwnership(IRSB* sbOut, IRExpr* guard){
   if (VG_(sizeXA)(tempDebt) == 0){
+    addStoreGC(sbOut, guard, mkU64((uintptr_t)tempArena), &tempArenaNext);
     addStoreGC(sbOut, guard, mkU64(0), &blockStateDirty);
     return;
   }
@@ -106,13 +107,24 @@ void addDynamicDisownNonNullDetached(IRSB* sbOut, IRExpr* st){
                Ity_I64,
                mkIRExprVec_1(st));
 }
+// Temps from the arena go away with it at the end of the block, so
+// only the ones that spilled off of it get pushed back on the
+// freelists.
+IRExpr* runOffTempArena(IRSB* sbOut, IRExpr* shadow_temp){
+  IRExpr* arenaOffset =
+    runBinop(sbOut, Iop_Sub64, shadow_temp, mkU64((uintptr_t)tempArena));
+  return runBinop(sbOut, Iop_CmpLE64U,
+                  mkU64(TEMP_ARENA_SLOTS * sizeof(ArenaTempSlot)),
+                  arenaOffset);
+}
 void addDisownNonNull(IRSB* sbOut, IRExpr* shadow_temp, int num_vals){
   IRExpr* valuesAddr = runArrow(sbOut, shadow_temp, ShadowTemp, values);
   for(int i = 0; i < num_vals; ++i){
     IRExpr* value = runIndex(sbOut, valuesAddr, ShadowValue*, i);
     addSVDisown(sbOut, value);
   }
-  addStackPush(sbOut, freedTemps[num_vals - 1], shadow_temp);
+  addStackPushG(sbOut, runOffTempArena(sbOut, shadow_temp),
+                freedTemps[num_vals - 1], shadow_temp);
 }
 void addDisown(IRSB* sbOut, IRExpr* shadow_temp, int num_vals){
   IRExpr* tempNonNull = runNonZeroCheck64(sbOut, shadow_temp);
@@ -124,8 +136,10 @@ void addDisown(IRSB* sbOut, IRExpr* shadow_temp, int num_vals){
                               ShadowValue*, i);
     addSVDisownG(sbOut, tempNonNull, value);
   }
-  addStackPushG(sbOut, tempNonNull, freedTemps[num_vals - 1],
-                shadow_temp);
+  addStackPushG(sbOut,
+                runAnd(sbOut, tempNonNull,
+                       runOffTempArena(sbOut, shadow_temp)),
+                freedTemps[num_vals - 1], shadow_temp);
 }
 void addDisownG(IRSB* sbOut, IRExpr* guard, IRExpr* shadow_temp, int num_vals){
   IRExpr* valuesAddr =
@@ -136,8 +150,9 @@ void addDisownG(IRSB* sbOut, IRExpr* guard, IRExpr* shadow_temp, int num_vals){
                               ShadowValue*, i);
     addSVDisownG(sbOut, guard, value);
   }
-  addStackPushG(sbOut, guard, freedTemps[num_vals - 1],
-                shadow_temp);
+  addStackPushG(sbOut,
+                runAnd(sbOut, guard, runOffTempArena(sbOut, shadow_temp)),
+                freedTemps[num_vals - 1], shadow_temp);
 }
 void addSVOwn(IRSB* sbOut, IRExpr* sv){
   IRExpr* valueNonNull = runNonZeroCheck64(sbOut, sv);
@@ -34,6 +34,7 @@
 #include "pub_tool_libcprint.h"
 #include "pub_tool_mallocfree.h"
 #include "pub_tool_hashtable.h"
+#include "pub_tool_xarray.h"
 
 #include "../helper/instrument-util.h"
 #include "../helper/debug.h"
@@ -48,6 +49,12 @@
 
 VgHashTable* opInfoTable = NULL;
 
+// The ops of the shadow program we're building up for the current
+// block, and the temps they read or write. See flushShadowProgram.
+static XArray* pendingOps = NULL;
+static Bool tempInShadowProgram[MAX_TEMPS];
+static XArray* shadowProgramTemps = NULL;
+
 long int cmpSemOpInfoEntry(const void* node1, const void* node2){
   const SemOpInfoEntry* entry1 = (const SemOpInfoEntry*)node1;
   const SemOpInfoEntry* entry2 = (const SemOpInfoEntry*)node2;
@@ -74,18 +81,225 @@ void instrumentSemanticOp(IRSB* sbOut, IROp op_code,
     addPrintOp(op_code);
     addPrint("\n");
   }
-  IRExpr* shadowOutput = runShadowOp(sbOut, mkU1(True),
-                                     op_code,
-                                     curAddr, blockAddr,
-                                     nargs, argExprs,
-                                     IRExpr_RdTmp(dest));
-  addStoreTemp(sbOut, shadowOutput, dest);
+  addShadowProgramOp(sbOut, op_code, curAddr, blockAddr,
+                     nargs, argExprs, dest);
+  // When sampling, the op might not run, leaving its arguments and
+  // result unshadowed.
+  ShadowStatus status = SAMPLING ? Ss_Unknown : Ss_Shadowed;
   for (int i = 0; i < nargs; ++i){
     if (argExprs[i]->tag == Iex_RdTmp){
-      tempShadowStatus[argExprs[i]->Iex.RdTmp.tmp] = Ss_Shadowed;
+      tempShadowStatus[argExprs[i]->Iex.RdTmp.tmp] = status;
     }
   }
-  tempShadowStatus[dest] = Ss_Shadowed;
+  tempShadowStatus[dest] = status;
+}
+
+static void addShadowProgramTemp(IRTemp temp){
+  if (!tempInShadowProgram[temp]){
+    tempInShadowProgram[temp] = True;
+    VG_(addToXA)(shadowProgramTemps, &temp);
+  }
+}
+// Instead of calling out to executeShadowOp right here, save off the
+// client values the op needs, and add it to the block's shadow
+// program, to be run later by flushShadowProgram.
+void addShadowProgramOp(IRSB* sbOut, IROp op_code,
+                        Addr curAddr, Addr blockAddr,
+                        int nargs, IRExpr** argExprs,
+                        IRTemp dest){
+  if (opInfoTable == NULL){
+    opInfoTable = VG_(HT_construct)("Operation Info Table");
+  }
+  if (pendingOps == NULL){
+    pendingOps = VG_(newXA)(VG_(malloc), "pending shadow ops",
+                            VG_(free), sizeof(ShadowProgramOp*));
+    shadowProgramTemps = VG_(newXA)(VG_(malloc), "shadow program temps",
+                                    VG_(free), sizeof(IRTemp));
+  }
+  ShadowProgramOp* op = VG_(perm_malloc)(sizeof(ShadowProgramOp),
+                                         vg_alignof(ShadowProgramOp));
+  op->instance =
+    getSemanticOpInfoInstance(curAddr, blockAddr, op_code,
+                              nargs, argExprs);
+  op->dest = dest;
+  op->nargs = nargs;
+  for(int i = 0; i < nargs; ++i){
+    addStoreC(sbOut, argExprs[i],
+              (uintptr_t)
+              (opArgPrecision(op_code) ?
+               ((void*)op->args.argValuesF[i]) :
+               ((void*)op->args.argValues[i])));
+    if (argExprs[i]->tag == Iex_RdTmp){
+      cleanupAtEndOfBlock(sbOut, argExprs[i]->Iex.RdTmp.tmp);
+      addShadowProgramTemp(argExprs[i]->Iex.RdTmp.tmp);
+    }
+  }
+  addStoreC(sbOut, IRExpr_RdTmp(dest), &(op->result));
+  cleanupAtEndOfBlock(sbOut, dest);
+  addShadowProgramTemp(dest);
+  VG_(addToXA)(pendingOps, &op);
+}
+// Run all the ops that have been added to the shadow program so far,
+// with one dirty call.
+void flushShadowProgram(IRSB* sbOut){
+  if (pendingOps == NULL || VG_(sizeXA)(pendingOps) == 0){
+    return;
+  }
+  ShadowProgram* program =
+    VG_(perm_malloc)(sizeof(ShadowProgram), vg_alignof(ShadowProgram));
+  program->num_ops = VG_(sizeXA)(pendingOps);
+  program->ops =
+    VG_(perm_malloc)(sizeof(ShadowProgramOp*) * program->num_ops,
+                     vg_alignof(ShadowProgramOp*));
+  for(int i = 0; i < program->num_ops; ++i){
+    program->ops[i] = *(ShadowProgramOp**)VG_(indexXA)(pendingOps, i);
+  }
+  IRDirty* dirty =
+    unsafeIRDirty_0_N(1, "executeShadowProgram",
+                      VG_(fnptr_to_fnentry)(executeShadowProgram),
+                      mkIRExprVec_1(mkU64((uintptr_t)program)));
+  dirty->mFx = Ifx_Modify;
+  dirty->mAddr = mkU64((uintptr_t)shadowTemps);
+  dirty->mSize = sizeof(shadowTemps);
+  if (SAMPLING){
+    // Outside of a sampled burst, none of the ops run, and their
+    // results are left NULL, so later uses reseed from the client
+    // value.
+    dirty->guard =
+      runNonZeroCheck64(sbOut, runLoad64C(sbOut, &shadowingActive));
+  }
+  addStmtToIRSB(sbOut, IRStmt_Dirty(dirty));
+
+  VG_(deleteXA)(pendingOps);
+  pendingOps = VG_(newXA)(VG_(malloc), "pending shadow ops",
+                          VG_(free), sizeof(ShadowProgramOp*));
+  for(int i = 0; i < VG_(sizeXA)(shadowProgramTemps); ++i){
+    tempInShadowProgram[*(IRTemp*)VG_(indexXA)(shadowProgramTemps, i)] =
+      False;
+  }
+  VG_(deleteXA)(shadowProgramTemps);
+  shadowProgramTemps = VG_(newXA)(VG_(malloc), "shadow program temps",
+                                  VG_(free), sizeof(IRTemp));
+}
+static Bool exprUsesShadowProgram(IRExpr* expr){
+  if (expr == NULL){
+    return False;
+  }
+  switch(expr->tag){
+  case Iex_RdTmp:
+    return tempInShadowProgram[expr->Iex.RdTmp.tmp];
+  case Iex_GetI:
+    return exprUsesShadowProgram(expr->Iex.GetI.ix);
+  case Iex_Qop:
+    return exprUsesShadowProgram(expr->Iex.Qop.details->arg1) ||
+      exprUsesShadowProgram(expr->Iex.Qop.details->arg2) ||
+      exprUsesShadowProgram(expr->Iex.Qop.details->arg3) ||
+      exprUsesShadowProgram(expr->Iex.Qop.details->arg4);
+  case Iex_Triop:
+    return exprUsesShadowProgram(expr->Iex.Triop.details->arg1) ||
+      exprUsesShadowProgram(expr->Iex.Triop.details->arg2) ||
+      exprUsesShadowProgram(expr->Iex.Triop.details->arg3);
+  case Iex_Binop:
+    return exprUsesShadowProgram(expr->Iex.Binop.arg1) ||
+      exprUsesShadowProgram(expr->Iex.Binop.arg2);
+  case Iex_Unop:
+    return exprUsesShadowProgram(expr->Iex.Unop.arg);
+  case Iex_Load:
+    return exprUsesShadowProgram(expr->Iex.Load.addr);
+  case Iex_ITE:
+    return exprUsesShadowProgram(expr->Iex.ITE.cond) ||
+      exprUsesShadowProgram(expr->Iex.ITE.iftrue) ||
+      exprUsesShadowProgram(expr->Iex.ITE.iffalse);
+  case Iex_CCall:
+    for(int i = 0; expr->Iex.CCall.args[i] != NULL; ++i){
+      if (exprUsesShadowProgram(expr->Iex.CCall.args[i])){
+        return True;
+      }
+    }
+    return False;
+  default:
+    return False;
+  }
+}
+// Whether a statement gets instrumented with a call to
+// instrumentSemanticOp, and so can be added to the shadow program.
+static Bool isShadowProgramStmt(IRStmt* stmt){
+  if (stmt->tag != Ist_WrTmp){
+    return False;
+  }
+  IRExpr* expr = stmt->Ist.WrTmp.data;
+  IROp op_code;
+  switch(expr->tag){
+  case Iex_Unop:
+    op_code = expr->Iex.Unop.op;
+    break;
+  case Iex_Binop:
+    op_code = expr->Iex.Binop.op;
+    break;
+  case Iex_Triop:
+    op_code = expr->Iex.Triop.details->op;
+    break;
+  case Iex_Qop:
+    op_code = expr->Iex.Qop.details->op;
+    break;
+  default:
+    return False;
+  }
+  return isFloatOp(op_code) && !isSpecialOp(op_code) &&
+    !isExitFloatOp(op_code) && !isConversionOp(op_code);
+}
+// The shadow program has to run before anything else gets a chance
+// to look at the temps it reads or writes, since getArg and
+// executeShadowOp can fill in its argument temps, and before the
+// block can be left.
+void flushShadowProgramBefore(IRSB* sbOut, IRStmt* stmt){
+  if (pendingOps == NULL || VG_(sizeXA)(pendingOps) == 0 ||
+      isShadowProgramStmt(stmt)){
+    return;
+  }
+  Bool shouldFlush;
+  switch(stmt->tag){
+  case Ist_NoOp:
+  case Ist_IMark:
+  case Ist_AbiHint:
+  case Ist_MBE:
+    shouldFlush = False;
+    break;
+  case Ist_Put:
+    shouldFlush = exprUsesShadowProgram(stmt->Ist.Put.data);
+    break;
+  case Ist_PutI:
+    shouldFlush =
+      exprUsesShadowProgram(stmt->Ist.PutI.details->ix) ||
+      exprUsesShadowProgram(stmt->Ist.PutI.details->data);
+    break;
+  case Ist_WrTmp:
+    shouldFlush = exprUsesShadowProgram(stmt->Ist.WrTmp.data);
+    break;
+  case Ist_Store:
+    shouldFlush =
+      exprUsesShadowProgram(stmt->Ist.Store.addr) ||
+      exprUsesShadowProgram(stmt->Ist.Store.data);
+    break;
+  case Ist_StoreG:
+    shouldFlush =
+      exprUsesShadowProgram(stmt->Ist.StoreG.details->addr) ||
+      exprUsesShadowProgram(stmt->Ist.StoreG.details->data) ||
+      exprUsesShadowProgram(stmt->Ist.StoreG.details->guard);
+    break;
+  case Ist_LoadG:
+    shouldFlush =
+      exprUsesShadowProgram(stmt->Ist.LoadG.details->addr) ||
+      exprUsesShadowProgram(stmt->Ist.LoadG.details->alt) ||
+      exprUsesShadowProgram(stmt->Ist.LoadG.details->guard);
+    break;
+  default:
+    shouldFlush = True;
+    break;
+  }
+  if (shouldFlush){
+    flushShadowProgram(sbOut);
+  }
 }
 
 IRExpr* runShadowOp(IRSB* sbOut, IRExpr* guard,
@@ -127,6 +341,15 @@ IRExpr* runShadowOp(IRSB* sbOut, IRExpr* guard,
     sizeof(computedArgs)
     + sizeof(computedResult)
     + sizeof(shadowTemps);
+  if (SAMPLING){
+    // Outside of a sampled burst, skip the op and give it a NULL
+    // shadow, so later uses reseed from the client value.
+    IRExpr* active =
+      runNonZeroCheck64(sbOut, runLoad64C(sbOut, &shadowingActive));
+    dirty->guard = runAnd(sbOut, guard, active);
+    addStmtToIRSB(sbOut, IRStmt_Dirty(dirty));
+    return runITE(sbOut, active, IRExpr_RdTmp(dest), mkU64(0));
+  }
   dirty->guard = guard;
   addStmtToIRSB(sbOut, IRStmt_Dirty(dirty));
   return IRExpr_RdTmp(dest);
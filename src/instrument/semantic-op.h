@@ -44,6 +44,13 @@ void instrumentPossibleNegate(IRSB* sbOut,
                               IRExpr** argExprs, IRTemp dest,
                               Addr curAddr, Addr blockAddr);
 
+void addShadowProgramOp(IRSB* sbOut, IROp op_code,
+                        Addr curAddr, Addr blockAddr,
+                        int nargs, IRExpr** argExprs,
+                        IRTemp dest);
+void flushShadowProgram(IRSB* sbOut);
+void flushShadowProgramBefore(IRSB* sbOut, IRStmt* stmt);
+
 IRExpr* runShadowOp(IRSB* sbOut, IRExpr* guard,
                     IROp op_code,
                     Addr curAddr, Addr block_addr,
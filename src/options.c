@@ -85,6 +85,8 @@ Bool double_comparisons = False;
 Bool flip_ranges = False;
 Bool generalize_to_constant = True;
 Bool fullprec_exprs = False;
+Bool hashcons_exprs = False;
+Bool adaptive_precision = False;
 
 Bool no_exprs = False;
 Bool no_influences = False;
@@ -92,14 +94,19 @@ Bool no_reals = False;
 Bool use_ranges = True;
 Bool dummy = False;
 
+RealBackend real_backend = Rb_MPFR;
+
 Int precision = 1000;
 Int max_expr_block_depth = 5;
 double error_threshold = 5.0;
+double sample_rate = 1.0;
+Int sample_burst = 1000;
 Int max_influences = 20;
 const char* output_filename = NULL;
 
 // Called to process each command line option.
 Bool hg_process_cmd_line_option(const HChar* arg){
+  const HChar* tmp_str;
   if VG_XACT_CLO(arg, "--print-in-blocks", print_in_blocks, True) {}
   else if VG_XACT_CLO(arg, "--print-out-blocks", print_out_blocks, True) {}
   else if VG_XACT_CLO(arg, "--print-block-boundries", print_block_boundries, True) {}
@@ -147,6 +154,8 @@ Bool hg_process_cmd_line_option(const HChar* arg){
   else if VG_XACT_CLO(arg, "--no-compensation-detection", compensation_detection, False)
                        {}
   else if VG_XACT_CLO(arg, "--full-precision-exprs", fullprec_exprs, True) {}
+  else if VG_XACT_CLO(arg, "--hashcons-exprs", hashcons_exprs, True) {}
+  else if VG_XACT_CLO(arg, "--adaptive-precision", adaptive_precision, True) {}
   else if VG_XACT_CLO(arg, "--no-exprs", no_exprs, True) {}
   else if VG_XACT_CLO(arg, "--no-influences", no_influences, True) {}
   else if VG_XACT_CLO(arg, "--no-reals", no_reals, True) {}
@@ -158,7 +167,25 @@ Bool hg_process_cmd_line_option(const HChar* arg){
   else if VG_BINT_CLO(arg, "--max-expr-block-depth", max_expr_block_depth, 1, 100) {}
   else if VG_DBL_CLO(arg, "--error-threshold", error_threshold) {}
   else if VG_BINT_CLO(arg, "--max-influences", max_influences, 1, 1000) {}
+  else if VG_DBL_CLO(arg, "--sample-rate", sample_rate) {
+    if (sample_rate <= 0.0 || sample_rate > 1.0){
+      VG_(fmsg_bad_option)(arg, "Sample rate must be in (0, 1].\n");
+    }
+  }
+  else if VG_BINT_CLO(arg, "--sample-burst", sample_burst, 1, 100000000) {}
   else if VG_STR_CLO(arg, "--outfile", output_filename) {}
+  else if VG_STR_CLO(arg, "--real-backend", tmp_str) {
+    if (VG_(strcmp)(tmp_str, "mpfr") == 0){
+      real_backend = Rb_MPFR;
+    } else if (VG_(strcmp)(tmp_str, "dd") == 0){
+      real_backend = Rb_DD;
+    } else if (VG_(strcmp)(tmp_str, "qd") == 0){
+      real_backend = Rb_QD;
+    } else {
+      VG_(fmsg_bad_option)(arg, "Unknown real backend \"%s\"; "
+                           "expected mpfr, dd, or qd.\n", tmp_str);
+    }
+  }
   else return False;
   return True;
 }
@@ -166,6 +193,16 @@ Bool hg_process_cmd_line_option(const HChar* arg){
 void hg_print_usage(void){
   VG_(printf)("    --precision=value    "
               "Sets the mantissa size of the shadow \"real\" values. [1000]\n"
+              "    --real-backend=mpfr|dd|qd    "
+              "How to represent the shadow \"real\" values: MPFR at "
+              "--precision bits, or double-double (106 bits) or "
+              "quad-double (212 bits) arithmetic, which is much faster. "
+              "Transcendental operations always go through MPFR. [mpfr]\n"
+              "    --adaptive-precision    "
+              "Under the MPFR backend, only give each shadow value as "
+              "many bits as it takes to hold it exactly, up to "
+              "--precision. Results are the same, but most adds and "
+              "multiplies get much cheaper.\n"
               "    --error-threshold=bits    "
               "The number of bits of error at which to start "
               "tracking a computation. [5.0]\n"
@@ -207,8 +244,19 @@ void hg_print_usage(void){
               "    --no-compensation-detection    "
               "Don't attempt to detect compensating terms and prune "
               "influences accordingly.\n"
+              "    --hashcons-exprs    "
+              "Share concrete expression nodes between executions of "
+              "an op that produce the same value from the same "
+              "arguments, to save memory in loops.\n"
               "    --follow-real-exeuction    "
               "Use high-precision values when converting to integers and booleans.\n"
+              "    --sample-rate=<fraction>    "
+              "Only shadow roughly this fraction of the program's "
+              "execution, and estimate op errors from the sample. "
+              "Defaults to 1 (shadow everything).\n"
+              "    --sample-burst=<blocks>    "
+              "When sampling, how many blocks to run before deciding "
+              "again whether to shadow. Defaults to 1000.\n"
               );
 }
 void hg_print_debug_usage(void){
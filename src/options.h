@@ -86,6 +86,8 @@ extern Bool double_comparisons;
 extern Bool flip_ranges;
 extern Bool generalize_to_constant;
 extern Bool fullprec_exprs;
+extern Bool hashcons_exprs;
+extern Bool adaptive_precision;
 
 extern Bool no_exprs;
 extern Bool no_influences;
@@ -93,9 +95,18 @@ extern Bool no_reals;
 extern Bool use_ranges;
 extern Bool dummy;
 
+typedef enum {
+  Rb_MPFR,
+  Rb_DD,
+  Rb_QD,
+} RealBackend;
+extern RealBackend real_backend;
+
 extern Int precision;
 extern Int max_expr_block_depth;
 extern double error_threshold;
+extern double sample_rate;
+extern Int sample_burst;
 extern Int max_influences;
 extern const char* output_filename;
 
@@ -106,6 +117,7 @@ Bool hg_process_cmd_line_option(const HChar* arg);
 void hg_print_usage(void);
 void hg_print_debug_usage(void);
 #define RUNNING (running_depth > 0)
+#define SAMPLING (sample_rate < 1.0)
 #define PRINT_VALUE_MOVES (print_value_moves && (RUNNING || always_on))
 #define PRINT_TEMP_MOVES (print_temp_moves && (RUNNING || always_on))
 #define PRINT_IN_BLOCKS (print_in_blocks && (RUNNING || always_on))
@@ -49,7 +49,7 @@ void maybeMarkImportantAtAddr(ShadowValue* val, double clientValue,
   if (val == NULL) return;
   MarkInfo* info = getMarkInfo(callAddr, argIdx, nargs);
   double thisError =
-    updateError(&(info->eagg), val->real, clientValue);
+    updateError(&(info->eagg), val, clientValue);
   if (thisError >= error_threshold){
     inPlaceMergeInfluences(&(info->influences), val->influences);
   }
@@ -65,6 +65,11 @@ void markImportant(ShadowValue* val, double clientValue, int argIdx, int nargs){
   Addr callAddr = getCallAddr();
   MarkInfo* info = getMarkInfo(callAddr, argIdx, nargs);
   if (val == NULL){
+    if (SAMPLING){
+      // The value was most likely dropped outside of a sampled
+      // burst, so there's nothing to learn from it.
+      return;
+    }
     VG_(umsg)("This mark couldn't find a shadow value! This means either it lost the value, or there were no floating point operations on this value prior to hitting this mark.\n");
     if (info->eagg.max_error < 0){
       info->eagg.max_error = 0;
@@ -73,7 +78,7 @@ void markImportant(ShadowValue* val, double clientValue, int argIdx, int nargs){
     return;
   }
   double thisError =
-    updateError(&(info->eagg), val->real, clientValue);
+    updateError(&(info->eagg), val, clientValue);
   if (thisError >= error_threshold){
     inPlaceMergeInfluences(&(info->influences), val->influences);
   }
@@ -137,6 +142,7 @@ MarkInfo* getMarkInfo(Addr callAddr, int argIdx, int nargs){
       markInfoArray->marks[i].influences = NULL;
       markInfoArray->marks[i].eagg.max_error = -1;
       markInfoArray->marks[i].eagg.total_error = 0;
+      markInfoArray->marks[i].eagg.total_squared_error = 0;
       markInfoArray->marks[i].eagg.num_evals = 0;
     }
     markInfoArray->addr = callAddr;
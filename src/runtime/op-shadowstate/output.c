@@ -39,8 +39,11 @@
 #include "../../options.h"
 
 #include "../shadowop/symbolic-op.h"
+#include "../shadowop/shadowop.h"
 #include "../../helper/runtime-util.h"
 
+#include <math.h>
+
 #define ENTRY_BUFFER_SIZE 2048000
 
 void writeOutput(void){
@@ -159,11 +162,16 @@ void writeOutput(void){
       unsigned int entryLen = ENTRY_BUFFER_SIZE - buf->bound;
       VG_(write)(fileD, _buf, entryLen);
 
-      InfluenceList filteredInfluences = filterInfluenceSubexprs(markInfo->influences);
+      InfluenceList subexprFiltered = filterInfluenceSubexprs(markInfo->influences);
+      InfluenceList filteredInfluences = subexprFiltered;
       if (only_improvable){
-        filteredInfluences = filterUnimprovableInfluences(filteredInfluences);
+        filteredInfluences = filterUnimprovableInfluences(subexprFiltered);
       }
       writeInfluences(fileD, filteredInfluences);
+      if (filteredInfluences != subexprFiltered){
+        freeInfluenceList(filteredInfluences);
+      }
+      freeInfluenceList(subexprFiltered);
       if (output_sexp){
         char endparens[] = "  )\n)";
         VG_(write)(fileD, endparens, sizeof(endparens) - 1);
@@ -261,11 +269,16 @@ void writeOutput(void){
     unsigned int entryLen = ENTRY_BUFFER_SIZE - buf->bound;
     VG_(write)(fileD, _buf, entryLen);
 
-    InfluenceList filteredInfluences = filterInfluenceSubexprs(intMarkInfo->influences);
+    InfluenceList subexprFiltered = filterInfluenceSubexprs(intMarkInfo->influences);
+    InfluenceList filteredInfluences = subexprFiltered;
     if (only_improvable){
-      filteredInfluences = filterUnimprovableInfluences(filteredInfluences);
+      filteredInfluences = filterUnimprovableInfluences(subexprFiltered);
     }
     writeInfluences(fileD, filteredInfluences);
+    if (filteredInfluences != subexprFiltered){
+      freeInfluenceList(filteredInfluences);
+    }
+    freeInfluenceList(subexprFiltered);
     if (output_sexp){
       char endparens[] = "  )\n"
         ")\n\n";
@@ -413,7 +426,7 @@ void writeInfluences(Int fileD, InfluenceList influences){
                 "     (max-error %f)\n"
                 "     (avg-local-error %f)\n"
                 "     (max-local-error %f)\n"
-                "     (num-calls %lld))\n",
+                "     (num-calls %lld)",
                 global_error.total_error
                 / global_error.num_evals,
                 global_error.max_error,
@@ -421,6 +434,10 @@ void writeInfluences(Int fileD, InfluenceList influences){
                 / global_error.num_evals,
                 local_error.max_error,
                 global_error.num_evals);
+      if (SAMPLING){
+        writeSampleEstimate(buf, &global_error);
+      }
+      printBBuf(buf, ")\n");
     } else {
       if (!no_exprs){
         printBBuf(buf,
@@ -487,6 +504,14 @@ void writeInfluences(Int fileD, InfluenceList influences){
                 / global_error.num_evals,
                 local_error.max_error,
                 global_error.num_evals);
+      if (SAMPLING){
+        writeSampleEstimate(buf, &global_error);
+      }
+      if (opinfo->skipped_merges > 0){
+        printBBuf(buf,
+                  "   Skipped %llu expression merges after converging\n",
+                  opinfo->skipped_merges);
+      }
     }
     unsigned int entryLen = ENTRY_BUFFER_SIZE - buf->bound;
     VG_(free)(exprString);
@@ -499,6 +524,36 @@ void writeInfluences(Int fileD, InfluenceList influences){
   }
 }
 
+void writeSampleEstimate(BBuf* buf, ErrorAggregate* agg){
+  // Treat each sampled execution as an independent draw; since
+  // samples come in bursts this is somewhat optimistic.
+  double margin = 64.0;
+  if (agg->num_evals > 1){
+    double mean = agg->total_error / agg->num_evals;
+    double variance =
+      (agg->total_squared_error - agg->num_evals * mean * mean)
+      / (agg->num_evals - 1);
+    if (variance < 0){
+      variance = 0;
+    }
+    margin = 1.96 * sqrt(variance / agg->num_evals);
+  }
+  long long int estimatedCalls =
+    (long long int)(agg->num_evals * sampleScale());
+  if (output_sexp){
+    printBBuf(buf,
+              "\n"
+              "     (estimated-num-calls %lld)\n"
+              "     (avg-error-margin %f)",
+              estimatedCalls, margin);
+  } else {
+    printBBuf(buf,
+              "   Sampled from an estimated %lld instances; "
+              "average error is within %f bits with 95%% confidence\n",
+              estimatedCalls, margin);
+  }
+}
+
 void writeProblematicRanges(BBuf* buf, int numVars, RangeRecord* problematicRanges){
   if (output_sexp){
     printBBuf(buf, "     (var-problematic-ranges");
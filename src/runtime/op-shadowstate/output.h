@@ -43,6 +43,7 @@ void writeRangesAndExample(BBuf* buf, int numVars,
                            RangeRecord* ranges,
                            RangeRecord* problematicRanges,
                            double* exampleProblematicInput);
+void writeSampleEstimate(BBuf* buf, ErrorAggregate* agg);
 void writeProblematicRanges(BBuf* buf, int numVars, RangeRecord* problematicRanges);
 void writeExample(BBuf* buf, int numVars, double* exampleProblematicInput);
 void writeRanges(BBuf* buf, int numVars, RangeRecord* ranges);
@@ -60,6 +60,8 @@ ShadowOpInfo* mkShadowOpInfo(IROp_Extended op_code, OpType type,
   result->op_type = type;
 
   result->expr = NULL;
+  result->stable_merges = 0;
+  result->skipped_merges = 0;
   if (nargs != numFloatArgs(result)){
     printOpInfo(result);
     VG_(printf)("\n");
@@ -74,6 +76,7 @@ ShadowOpInfo* mkShadowOpInfo(IROp_Extended op_code, OpType type,
 void initializeErrorAggregate(ErrorAggregate* error_agg){
   error_agg->max_error = -1;
   error_agg->total_error = 0;
+  error_agg->total_squared_error = 0;
   error_agg->num_evals = 0;
 }
 
@@ -153,7 +156,7 @@ void printOpInfo(ShadowOpInfo* opinfo){
 
 void updateInputRecords(InputsRecord* record, ShadowValue** args, int nargs){
   for (int i = 0; i < nargs; ++i){
-    updateRangeRecord(record->range_records + i, getDouble(args[i]->real));
+    updateRangeRecord(record->range_records + i, getValDouble(args[i]));
   }
 }
 
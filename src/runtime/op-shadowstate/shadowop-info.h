@@ -49,6 +49,9 @@ extern VgHashTable* intMarkMap;
 typedef struct _ErrorAggregate {
   double max_error;
   double total_error;
+  // Kept so that sampled runs can report how confident their average
+  // is.
+  double total_squared_error;
   long long int num_evals;
 } ErrorAggregate;
 
@@ -71,6 +74,10 @@ typedef struct _ShadowOpInfo {
   Addr block_addr;
   Aggregate agg;
   SymbExpr* expr;
+  // How many merges in a row into expr have left it unchanged, and
+  // how many we've skipped since it converged.
+  UInt stable_merges;
+  ULong skipped_merges;
 } ShadowOpInfo;
 
 typedef struct _ShadowOpInfoInstance {
@@ -35,18 +35,38 @@
 #include "pub_tool_libcprint.h"
 #include <math.h>
 
+// Most ops are off by only a handful of ulps, so keep the bits of
+// error for those around instead of taking a log2 for every op.
+#define SMALL_ULPS_ERRORS 256
+static double smallUlpsBits[SMALL_ULPS_ERRORS];
+
+void initErrorTables(void){
+  for(int i = 0; i < SMALL_ULPS_ERRORS; ++i){
+    smallUlpsBits[i] = log2(i + 1);
+  }
+}
+
+double bitsOfUlps(ULong ulpsError){
+  if (ulpsError < SMALL_ULPS_ERRORS){
+    return smallUlpsBits[ulpsError];
+  }
+  ULong ulpsPlusOne = ulpsError + 1;
+  // Powers of two come out exact, so take them straight from the bit
+  // position.
+  if ((ulpsPlusOne & (ulpsPlusOne - 1)) == 0 && ulpsPlusOne != 0){
+    return 63 - __builtin_clzll(ulpsPlusOne);
+  }
+  return log2(ulpsPlusOne);
+}
+
 double updateError(ErrorAggregate* eagg,
-                   Real realVal, double computedVal){
+                   ShadowValue* val, double computedVal){
   if (no_reals) return 0.0;
-  double shadowRounded = getDouble(realVal);
+  double shadowRounded = getValDouble(val);
   ULong ulpsError = ulpd(shadowRounded, computedVal);
 
-  double bitsError = log2(ulpsError + 1);
-  if (bitsError > eagg->max_error){
-    eagg->max_error = bitsError;
-  }
-  eagg->total_error += bitsError;
-  eagg->num_evals += 1;
+  double bitsError = bitsOfUlps(ulpsError);
+  addErrors(eagg, &bitsError, 1);
 
 
   // Debug printing code
@@ -54,7 +74,7 @@ double updateError(ErrorAggregate* eagg,
   if (print_errors_long || print_errors){
     if (print_errors_long){
       VG_(printf)("The shadow value is ");
-      printReal(realVal);
+      printReal(val->real);
     } else {
       if (shadowRounded != shadowRounded){
         VG_(printf)("The rounded shadow value is NaN");
@@ -76,6 +96,17 @@ double updateError(ErrorAggregate* eagg,
   return bitsError;
 }
 
+void addErrors(ErrorAggregate* eagg, double* bitsErrors, int numErrors){
+  for(int i = 0; i < numErrors; ++i){
+    if (bitsErrors[i] > eagg->max_error){
+      eagg->max_error = bitsErrors[i];
+    }
+    eagg->total_error += bitsErrors[i];
+    eagg->total_squared_error += bitsErrors[i] * bitsErrors[i];
+  }
+  eagg->num_evals += numErrors;
+}
+
 ULong ulpd(double x, double y){
   if (x == 0) x = 0; // -0 == 0
   if (y == 0) y = 0; // -0 == 0
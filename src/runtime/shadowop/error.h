@@ -31,10 +31,17 @@
 #define _ERROR_H
 
 #include "../value-shadowstate/real.h"
+#include "../value-shadowstate/shadowval.h"
 #include "../op-shadowstate/shadowop-info.h"
 
 double updateError(ErrorAggregate* eagg,
-                   Real realVal, double computedVal);
+                   ShadowValue* val, double computedVal);
+// Bits of error for a given ulps distance, the same as
+// log2(ulpsError + 1). Call initErrorTables before using it.
+void initErrorTables(void);
+double bitsOfUlps(ULong ulpsError);
+// Record several already-computed errors at once.
+void addErrors(ErrorAggregate* eagg, double* bitsErrors, int numErrors);
 ULong ulpd(double val1, double val2);
 
 #endif
@@ -41,8 +41,8 @@ VG_REGPARM(1) void checkCompare(ShadowCmpInfo* info){
   unsigned int correctOutput;
   if (numSIMDOperands(info->op_code) == 1){
     if (double_comparisons){
-      double correctFst = getDouble(args[0]->values[0]->real);
-      double correctSnd = getDouble(args[1]->values[0]->real);
+      double correctFst = getValDouble(args[0]->values[0]);
+      double correctSnd = getValDouble(args[1]->values[0]);
       switch(info->op_code){
       case Iop_CmpF64:
       case Iop_CmpF32:{
@@ -208,7 +208,7 @@ VG_REGPARM(1) void checkCompare(ShadowCmpInfo* info){
 VG_REGPARM(3) void checkConvert(IROp_Extended op, IRTemp tmp,
                                 Addr curAddr){
   ShadowTemp* arg = getArg(0, op, tmp);
-  int correctResult = (int)getDouble(arg->values[0]->real);
+  int correctResult = (int)getValDouble(arg->values[0]);
   int computedValue =
     *((int*)&computedResult.f[0]);
   markEscapeFromFloat("convert",
@@ -55,9 +55,7 @@ void execInfluencesOp(ShadowOpInfo* info,
                                                  flagged ? info : NULL);
 
     *res = mergeInfluences(intermediary, args[2]->influences, NULL);
-    if (intermediary != NULL){
-      freeInfluenceList(intermediary);
-    }
+    disownInfluenceList(intermediary);
   } else {
     tl_assert(numFloatArgs(info) == 4);
     InfluenceList intermediary1 = mergeInfluences(args[0]->influences,
@@ -67,20 +65,14 @@ void execInfluencesOp(ShadowOpInfo* info,
                                                   args[3]->influences,
                                                   NULL);
     *res = mergeInfluences(intermediary1, intermediary2, NULL);
-    if (intermediary1 != NULL){
-      freeInfluenceList(intermediary1);
-    }
-    if (intermediary2 != NULL){
-      freeInfluenceList(intermediary2);
-    }
+    disownInfluenceList(intermediary1);
+    disownInfluenceList(intermediary2);
   }
 }
 
 void inPlaceMergeInfluences(InfluenceList* dest, InfluenceList arg){
   InfluenceList lst = mergeInfluences(*dest, arg, NULL);
-  if (*dest != NULL){
-    freeInfluenceList(*dest);
-  }
+  disownInfluenceList(*dest);
   *dest = lst;
 }
 void trackOpAsInfluence(ShadowOpInfo* info, ShadowValue* value){
@@ -88,13 +80,11 @@ void trackOpAsInfluence(ShadowOpInfo* info, ShadowValue* value){
     return;
   }
   InfluenceList lst = mergeInfluences(value->influences, NULL, info);
-  if (value->influences != NULL){
-    freeInfluenceList(value->influences);
-  }
+  disownInfluenceList(value->influences);
   value->influences = lst;
 }
 InfluenceList cloneInfluences(InfluenceList influences){
-  return mergeInfluences(influences, NULL, NULL);
+  return ownInfluenceList(influences);
 }
 
 void forceTrack(Addr varAddr){
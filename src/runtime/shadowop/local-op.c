@@ -35,13 +35,11 @@
 #include "../../options.h"
 #include "pub_tool_libcprint.h"
 
-double execLocalOp(ShadowOpInfo* info, Real realVal,
-                   ShadowValue* res, ShadowValue** args){
-  if (no_reals) return 0;
+static double locallyApproximate(ShadowOpInfo* info, ShadowValue** args){
   int nargs = numFloatArgs(info);
   double exactRoundedArgs[4];
   for(int i = 0; i < nargs; ++i){
-    exactRoundedArgs[i] = getDouble(args[i]->real);
+    exactRoundedArgs[i] = getValDouble(args[i]);
   }
   double locallyApproximateResult;
   if (info->op_code == 0x0){
@@ -51,5 +49,26 @@ double execLocalOp(ShadowOpInfo* info, Real realVal,
     locallyApproximateResult =
       runEmulatedOp(info->op_code, exactRoundedArgs);
   }
-  return updateError(&(info->agg.local_error), realVal, locallyApproximateResult);
+  return locallyApproximateResult;
+}
+
+double execLocalOp(ShadowOpInfo* info,
+                   ShadowValue* res, ShadowValue** args){
+  if (no_reals) return 0;
+  return updateError(&(info->agg.local_error), res,
+                     locallyApproximate(info, args));
+}
+
+void measureOpErrors(ShadowOpInfo* info, ShadowValue* res,
+                     ShadowValue** args, double clientResult,
+                     double* localError, double* globalError){
+  if (no_reals){
+    *localError = 0;
+    *globalError = 0;
+    return;
+  }
+  double shadowRounded = getValDouble(res);
+  *localError =
+    bitsOfUlps(ulpd(shadowRounded, locallyApproximate(info, args)));
+  *globalError = bitsOfUlps(ulpd(shadowRounded, clientResult));
 }
@@ -34,7 +34,13 @@
 #include "../value-shadowstate/shadowval.h"
 #include "../op-shadowstate/shadowop-info.h"
 
-double execLocalOp(ShadowOpInfo* info, Real realVal,
+double execLocalOp(ShadowOpInfo* info,
                    ShadowValue* res, ShadowValue** args);
+// Computes both the local and global error of an op result, rounding
+// the real result only once, without recording or printing either
+// one.
+void measureOpErrors(ShadowOpInfo* info, ShadowValue* res,
+                     ShadowValue** args, double clientResult,
+                     double* localError, double* globalError);
 
 #endif
@@ -39,6 +39,7 @@
 #include "../../helper/runtime-util.h"
 #include "../value-shadowstate/value-shadowstate.h"
 #include "realop.h"
+#include "shadowop.h"
 #include "error.h"
 #include "symbolic-op.h"
 #include "influence-op.h"
@@ -51,10 +52,16 @@
 #define NCALLFRAMES 5
 #define MAX_WRAPPED_ARGS 3
 
-void performWrappedOp(OpType type, double* resLoc, double* args){
+void performWrappedOp(OpType type, double* resLoc, double* args,
+                      Addr callAddr){
 #ifndef USE_MPFR
   tl_assert2(0, "Can't wrap math ops in GMP mode!\n");
 #endif
+  if (!RUNNING || !shadowingActive){
+    *resLoc = runEmulatedWrappedOp(type, args);
+    removeMemShadow((UWord)(uintptr_t)resLoc);
+    return;
+  }
   int nargs = getWrappedNumArgs(type);
   ValueType op_precision = getWrappedPrecision(type);
   ShadowValue* shadowArgs[MAX_WRAPPED_ARGS];
@@ -77,7 +84,7 @@ void performWrappedOp(OpType type, double* resLoc, double* args){
       VG_(printf)("Arg %d is computed as ", i + 1);
       ppFloat(args[i]);
       VG_(printf)(", and is shadowed as ");
-      ppFloat(getDouble(shadowArgs[i]->real));
+      ppFloat(getValDouble(shadowArgs[i]));
       VG_(printf)("\n");
     }
   }
@@ -86,19 +93,18 @@ void performWrappedOp(OpType type, double* resLoc, double* args){
   removeMemShadow((UWord)(uintptr_t)resLoc);
   addMemShadow((UWord)(uintptr_t)resLoc, shadowResult);
 
-  Addr callAddr = getCallAddr();
   ShadowOpInfo* info = getWrappedOpInfo(callAddr, type, nargs);
   if (print_errors_long || print_errors){
     printOpInfo(info);
     VG_(printf)(":\n");
   }
   double bitsGlobalError =
-    updateError(&(info->agg.global_error), shadowResult->real, *resLoc);
+    updateError(&(info->agg.global_error), shadowResult, *resLoc);
   execSymbolicOp(info, &(shadowResult->expr),
                  *resLoc, shadowArgs,
                  bitsGlobalError > error_threshold);
   double bitsLocalError =
-    execLocalOp(info, shadowResult->real, shadowResult, shadowArgs);
+    execLocalOp(info, shadowResult, shadowArgs);
   execInfluencesOp(info, &(shadowResult->influences), shadowArgs,
                    bitsLocalError >= error_threshold);
   if (print_influences){
@@ -135,7 +141,27 @@ void performWrappedOp(OpType type, double* resLoc, double* args){
   }
 }
 
+// Wrapped calls in a hot loop hit the same few call sites over and
+// over, so we keep a small direct-mapped cache of entries in front of
+// the hash table. Entries are never freed, so a cached pointer stays
+// good forever.
+#define WRAPPED_INFO_CACHE_BITS 10
+#define WRAPPED_INFO_CACHE_SIZE (1 << WRAPPED_INFO_CACHE_BITS)
+static MrOpInfoEntry* wrappedInfoCache[WRAPPED_INFO_CACHE_SIZE];
+
+static UWord wrappedInfoCacheIdx(Addr callAddr, OpType opType){
+  UWord hash = (callAddr ^ (callAddr >> WRAPPED_INFO_CACHE_BITS))
+    + opType * 0x9e3779b1;
+  return hash & (WRAPPED_INFO_CACHE_SIZE - 1);
+}
+
 ShadowOpInfo* getWrappedOpInfo(Addr callAddr, OpType opType, int nargs){
+  UWord cacheIdx = wrappedInfoCacheIdx(callAddr, opType);
+  MrOpInfoEntry* cached = wrappedInfoCache[cacheIdx];
+  if (cached != NULL &&
+      cached->call_addr == callAddr && cached->type == opType){
+    return cached->info;
+  }
   MrOpInfoEntry key = {.call_addr = callAddr, .type = opType};
   MrOpInfoEntry* entry =
     VG_(HT_gen_lookup)(mathreplaceOpInfoMap, &key, cmp_op_entry_by_type);
@@ -149,6 +175,7 @@ ShadowOpInfo* getWrappedOpInfo(Addr callAddr, OpType opType, int nargs){
     entry->type = opType;
     VG_(HT_add_node)(mathreplaceOpInfoMap, entry);
   }
+  wrappedInfoCache[cacheIdx] = entry;
   return entry->info;
 }
 
@@ -202,9 +229,31 @@ const char* getWrappedName(OpType type){
   }
 }
 
+static void runWrappedMPFROp(OpType type, ShadowValue* result,
+                             ShadowValue** shadowArgs);
+
 ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
   ShadowValue* result = mkShadowValueBare(getWrappedPrecision(type));
   if (no_reals) return result;
+  if (real_backend == Rb_MPFR){
+    if (adaptive_precision){
+      setRealPrecision(result->real, precision);
+    }
+    runWrappedMPFROp(type, result, shadowArgs);
+  } else {
+    // The library functions only exist in MPFR and MPC, so under the
+    // multi-double backends we convert through scratch reals.
+    ShadowValue* scratchArgs[NUM_SCRATCH_REALS];
+    ShadowValue* scratchResult = getMPFRScratchResult();
+    loadMPFRScratchArgs(scratchArgs, shadowArgs, getWrappedNumArgs(type));
+    runWrappedMPFROp(type, scratchResult, scratchArgs);
+    realFromMPFR(result->real, scratchResult->real->RVAL);
+  }
+  return result;
+}
+
+static void runWrappedMPFROp(OpType type, ShadowValue* result,
+                             ShadowValue** shadowArgs){
   switch(type){
   case OP_CDIVR:
   case OP_CDIVI:
@@ -374,9 +423,8 @@ ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
     break;
   default:
     tl_assert(0);
-    return NULL;
+    return;
   }
-  return result;
 }
 
 double runEmulatedWrappedOp(OpType type, double* args){
@@ -399,26 +447,27 @@ Word cmp_op_entry_by_type(const void* node1, const void* node2){
 }
 
 void performSpecialWrappedOp(SpecialOpType type, double* args,
-                             double* res1, double* res2){
+                             double* res1, double* res2,
+                             Addr callAddr){
 #ifndef USE_MPFR
   tl_assert2(0, "Can't wrap math ops in GMP mode!\n");
 #endif
   switch(type){
   case OP_SINCOS:
-    performWrappedOp(OP_SIN, res1, args);
-    performWrappedOp(OP_COS, res2, args);
+    performWrappedOp(OP_SIN, res1, args, callAddr);
+    performWrappedOp(OP_COS, res2, args, callAddr);
     break;
   case OP_SINCOSF:
-    performWrappedOp(OP_SINF, res1, args);
-    performWrappedOp(OP_COSF, res2, args);
+    performWrappedOp(OP_SINF, res1, args, callAddr);
+    performWrappedOp(OP_COSF, res2, args, callAddr);
     break;
   case OP_MODF:
-    performWrappedOp(OP_REMAINDER, res1, args);
-    performWrappedOp(OP_RINT, res2, args);
+    performWrappedOp(OP_REMAINDER, res1, args, callAddr);
+    performWrappedOp(OP_RINT, res2, args, callAddr);
     break;
   case OP_MODFF:
-    performWrappedOp(OP_REMAINDERF, res1, args);
-    performWrappedOp(OP_RINTF, res2, args);
+    performWrappedOp(OP_REMAINDERF, res1, args, callAddr);
+    performWrappedOp(OP_RINTF, res2, args, callAddr);
     break;
   }
 }
@@ -36,7 +36,8 @@
 #include "../../include/mathreplace-funcs.h"
 #include "../op-shadowstate/shadowop-info.h"
 
-void performWrappedOp(OpType type, double* args, double* resLoc);
+void performWrappedOp(OpType type, double* resLoc, double* args,
+                      Addr callAddr);
 ShadowOpInfo* getWrappedOpInfo(Addr callAddr, OpType opType, int nargs);
 int getWrappedNumArgs(OpType type);
 ValueType getWrappedPrecision(OpType type);
@@ -46,6 +47,7 @@ double runEmulatedWrappedOp(OpType type, double* args);
 Word cmp_op_entry_by_type(const void* node1, const void* node2);
 
 void performSpecialWrappedOp(SpecialOpType type, double* args,
-                             double* res1, double* res2);
+                             double* res1, double* res2,
+                             Addr callAddr);
 
 #endif
@@ -33,10 +33,463 @@
 #include "pub_tool_libcprint.h"
 #include "../../helper/ir-info.h"
 
+#include <math.h>
+
+static void execMPFRRealOp(IROp op_code, Real* result, ShadowValue** args);
+static void execMultiDoubleRealOp(IROp op_code, Real result,
+                                  ShadowValue** args);
+
+#ifdef USE_MPFR
+// How many bits it takes to hold the result of an op exactly, for
+// the ops where that's bounded; everything else gets the full
+// --precision, and so comes out the same as it would without
+// --adaptive-precision.
+static mpfr_prec_t exactPrecision(IROp op_code, ShadowValue** args){
+  switch((int)op_code){
+  case Iop_Abs32Fx4:
+  case Iop_Abs32Fx2:
+  case Iop_Abs64Fx2:
+  case Iop_AbsF32:
+  case Iop_AbsF64:
+  case Iop_Neg32Fx4:
+  case IEop_Neg32F0x4:
+  case Iop_Neg32Fx2:
+  case Iop_Neg64Fx2:
+  case IEop_Neg64F0x2:
+  case Iop_NegF32:
+  case Iop_NegF64:
+    return mpfr_get_prec(args[0]->real->RVAL);
+  case Iop_Add64Fx4:
+  case Iop_Add64Fx2:
+  case Iop_Add64F0x2:
+  case Iop_Add32F0x4:
+  case Iop_Add32Fx2:
+  case Iop_Add32Fx4:
+  case Iop_Add32Fx8:
+  case Iop_AddF128:
+  case Iop_AddF64:
+  case Iop_AddF32:
+  case Iop_AddF64r32:
+  case Iop_Sub64F0x2:
+  case Iop_Sub32F0x4:
+  case Iop_Sub32Fx2:
+  case Iop_Sub32Fx8:
+  case Iop_Sub64Fx4:
+  case Iop_Sub32Fx4:
+  case Iop_Sub64Fx2:
+  case Iop_SubF128:
+  case Iop_SubF32:
+  case Iop_SubF64:
+  case Iop_SubF64r32:{
+    mpfr_srcptr a = args[0]->real->RVAL;
+    mpfr_srcptr b = args[1]->real->RVAL;
+    if (!mpfr_regular_p(a)){
+      return mpfr_get_prec(b);
+    } else if (!mpfr_regular_p(b)){
+      return mpfr_get_prec(a);
+    }
+    // From the top bit of the bigger argument, plus one for a carry,
+    // down to the bottom bit of whichever argument reaches lower.
+    long aTop = mpfr_get_exp(a);
+    long bTop = mpfr_get_exp(b);
+    long aBottom = aTop - (long)mpfr_get_prec(a);
+    long bBottom = bTop - (long)mpfr_get_prec(b);
+    long span = (aTop > bTop ? aTop : bTop) -
+      (aBottom < bBottom ? aBottom : bBottom) + 1;
+    return span > precision ? precision : span;
+  }
+  case Iop_Mul32F0x4:
+  case Iop_Mul64F0x2:
+  case Iop_Mul32Fx8:
+  case Iop_Mul64Fx4:
+  case Iop_Mul32Fx4:
+  case Iop_Mul64Fx2:
+  case Iop_MulF128:
+  case Iop_MulF64:
+  case Iop_MulF32:
+  case Iop_MulF64r32:
+    return mpfr_get_prec(args[0]->real->RVAL) +
+      mpfr_get_prec(args[1]->real->RVAL);
+  default:
+    return precision;
+  }
+}
+#endif
+
 void execRealOp(IROp op_code, Real* result, ShadowValue** args){
   if (no_reals){
     return;
   }
+  if (real_backend == Rb_MPFR){
+    #ifdef USE_MPFR
+    if (adaptive_precision){
+      setRealPrecision(*result, exactPrecision(op_code, args));
+    }
+    #endif
+    execMPFRRealOp(op_code, result, args);
+  } else {
+    execMultiDoubleRealOp(op_code, *result, args);
+  }
+}
+
+static ULong doubleBits(double x){
+  return *((ULong*)&x);
+}
+static Bool isFiniteDouble(double x){
+  return ((doubleBits(x) >> 52) & 0x7ff) != 0x7ff;
+}
+static Bool isNormalDouble(double x){
+  ULong exponent = (doubleBits(x) >> 52) & 0x7ff;
+  return exponent != 0 && exponent != 0x7ff;
+}
+static Bool isPowerOfTwo(double x){
+  return isNormalDouble(x) && (doubleBits(x) & 0xfffffffffffffULL) == 0;
+}
+// Computes a + b, and returns whether it came out exact. Sterbenz's
+// lemma covers cancelling values cheaply; otherwise we check that the
+// TwoSum residual is zero.
+static Bool exactSum(double a, double b, double* sum){
+  *sum = a + b;
+  if (!isFiniteDouble(*sum)){
+    return False;
+  }
+  double aMag = a < 0 ? -a : a;
+  double bMag = b < 0 ? -b : b;
+  if ((a < 0) != (b < 0) && aMag <= 2 * bMag && bMag <= 2 * aMag){
+    return True;
+  }
+  double bVirtual = *sum - a;
+  double residual = (a - (*sum - bVirtual)) + (b - bVirtual);
+  return residual == 0;
+}
+// Computes a * b, and returns whether it came out exact, which we
+// only know for sure when one side is zero or a power of two and the
+// product stays normal.
+static Bool exactProduct(double a, double b, double* product){
+  *product = a * b;
+  if (a == 0 || b == 0){
+    return True;
+  }
+  return (isPowerOfTwo(a) || isPowerOfTwo(b)) && isNormalDouble(*product);
+}
+
+Bool execExactOp(IROp op_code, ShadowValue* result, ShadowValue** args){
+  if (no_reals){
+    return False;
+  }
+  double exactResult;
+  switch((int)op_code){
+  case Iop_Abs32Fx4:
+  case Iop_Abs32Fx2:
+  case Iop_Abs64Fx2:
+  case Iop_AbsF32:
+  case Iop_AbsF64:
+    if (args[0]->rounded_state != Rs_Exact){
+      return False;
+    }
+    {
+      ULong magnitude = doubleBits(args[0]->rounded) & ~(1ULL << 63);
+      exactResult = *((double*)&magnitude);
+    }
+    break;
+  case Iop_Neg32Fx4:
+  case IEop_Neg32F0x4:
+  case Iop_Neg32Fx2:
+  case Iop_Neg64Fx2:
+  case IEop_Neg64F0x2:
+  case Iop_NegF32:
+  case Iop_NegF64:
+    if (args[0]->rounded_state != Rs_Exact){
+      return False;
+    }
+    exactResult = -args[0]->rounded;
+    break;
+  case Iop_Add64Fx4:
+  case Iop_Add64Fx2:
+  case Iop_Add64F0x2:
+  case Iop_Add32F0x4:
+  case Iop_Add32Fx2:
+  case Iop_Add32Fx4:
+  case Iop_Add32Fx8:
+  case Iop_AddF64:
+  case Iop_AddF32:
+  case Iop_AddF64r32:
+  case Iop_Sub64F0x2:
+  case Iop_Sub32F0x4:
+  case Iop_Sub32Fx2:
+  case Iop_Sub32Fx8:
+  case Iop_Sub64Fx4:
+  case Iop_Sub32Fx4:
+  case Iop_Sub64Fx2:
+  case Iop_SubF32:
+  case Iop_SubF64:
+  case Iop_SubF64r32:
+  case Iop_Mul32F0x4:
+  case Iop_Mul64F0x2:
+  case Iop_Mul32Fx8:
+  case Iop_Mul64Fx4:
+  case Iop_Mul32Fx4:
+  case Iop_Mul64Fx2:
+  case Iop_MulF64:
+  case Iop_MulF32:
+  case Iop_MulF64r32:{
+    if (args[0]->rounded_state != Rs_Exact ||
+        args[1]->rounded_state != Rs_Exact){
+      return False;
+    }
+    double a = args[0]->rounded;
+    double b = args[1]->rounded;
+    if (!isFiniteDouble(a) || !isFiniteDouble(b)){
+      return False;
+    }
+    Bool exact;
+    switch((int)op_code){
+    case Iop_Mul32F0x4:
+    case Iop_Mul64F0x2:
+    case Iop_Mul32Fx8:
+    case Iop_Mul64Fx4:
+    case Iop_Mul32Fx4:
+    case Iop_Mul64Fx2:
+    case Iop_MulF64:
+    case Iop_MulF32:
+    case Iop_MulF64r32:
+      exact = exactProduct(a, b, &exactResult);
+      break;
+    case Iop_Sub64F0x2:
+    case Iop_Sub32F0x4:
+    case Iop_Sub32Fx2:
+    case Iop_Sub32Fx8:
+    case Iop_Sub64Fx4:
+    case Iop_Sub32Fx4:
+    case Iop_Sub64Fx2:
+    case Iop_SubF32:
+    case Iop_SubF64:
+    case Iop_SubF64r32:
+      exact = exactSum(a, -b, &exactResult);
+      break;
+    default:
+      exact = exactSum(a, b, &exactResult);
+      break;
+    }
+    if (!exact){
+      return False;
+    }
+  }
+    break;
+  default:
+    return False;
+  }
+  setReal_fast(result->real, exactResult);
+  result->rounded = exactResult;
+  result->rounded_state = Rs_Exact;
+  return True;
+}
+
+static ShadowValue scratchVals[NUM_SCRATCH_REALS];
+
+ShadowValue* getMPFRScratchResult(void){
+  scratchVals[0].real = getScratchReal(0);
+  return &(scratchVals[0]);
+}
+void loadMPFRScratchArgs(ShadowValue** scratchArgs,
+                         ShadowValue** args, int nargs){
+  tl_assert(nargs < NUM_SCRATCH_REALS);
+  for(int i = 0; i < nargs; ++i){
+    scratchVals[i + 1].real = getScratchReal(i + 1);
+    realToMPFR(scratchVals[i + 1].real->RVAL, args[i]->real);
+    scratchArgs[i] = &(scratchVals[i + 1]);
+  }
+}
+
+// The multi-double backends don't implement the transcendental ops,
+// so run those in MPFR on scratch copies of the arguments.
+static void execRealOpInMPFR(IROp op_code, Real result,
+                             ShadowValue** args, int nargs){
+  ShadowValue* scratchArgs[NUM_SCRATCH_REALS];
+  ShadowValue* scratchResult = getMPFRScratchResult();
+  loadMPFRScratchArgs(scratchArgs, args, nargs);
+  execMPFRRealOp(op_code, &(scratchResult->real), scratchArgs);
+  realFromMPFR(result, scratchResult->real->RVAL);
+}
+
+#define MDVAL(idx) (args[idx]->real->md_val)
+
+static void execMultiDoubleRealOp(IROp op_code, Real result,
+                                  ShadowValue** args){
+  int n = NUM_MD_PARTS;
+  double* res = result->md_val;
+  double tmp[MAX_MD_PARTS];
+  double constant[MAX_MD_PARTS];
+  switch((int)op_code){
+  case Iop_RecipEst32Fx4:
+  case Iop_RecipEst32Fx2:
+  case Iop_RecipEst64Fx2:
+  case Iop_RecipEst32F0x4:
+    mdSetD(constant, 1.0, n);
+    mdDiv(res, constant, MDVAL(0), n);
+    break;
+  case Iop_RSqrtEst32Fx4:
+  case Iop_RSqrtEst32F0x4:
+  case Iop_RSqrtEst64Fx2:
+  case Iop_RSqrtEst32Fx2:
+  case Iop_RSqrtEst5GoodF64:
+    mdSqrt(tmp, MDVAL(0), n);
+    mdSetD(constant, 1.0, n);
+    mdDiv(res, constant, tmp, n);
+    break;
+  case Iop_Abs32Fx4:
+  case Iop_Abs32Fx2:
+  case Iop_Abs64Fx2:
+  case Iop_AbsF32:
+  case Iop_AbsF64:
+    mdAbs(res, MDVAL(0), n);
+    break;
+  case Iop_Neg32Fx4:
+  case IEop_Neg32F0x4:
+  case Iop_Neg32Fx2:
+  case Iop_Neg64Fx2:
+  case IEop_Neg64F0x2:
+  case Iop_NegF32:
+  case Iop_NegF64:
+    mdNeg(res, MDVAL(0), n);
+    break;
+  case Iop_SqrtF64:
+  case Iop_SqrtF32:
+  case Iop_Sqrt32F0x4:
+  case Iop_Sqrt64F0x2:
+  case Iop_Sqrt64Fx2:
+    if (mdGetD(MDVAL(0), n) >= 0.0){
+      mdSqrt(res, MDVAL(0), n);
+    } else {
+      mdSetD(res, NAN, n);
+    }
+    break;
+  case Iop_RecipStep32Fx4:
+  case Iop_RecipStep32Fx2:
+  case Iop_RecipStep64Fx2:
+    mdMul(tmp, MDVAL(0), MDVAL(1), n);
+    mdSetD(constant, 2.0, n);
+    mdSub(res, constant, tmp, n);
+    break;
+  case Iop_RSqrtStep32Fx4:
+  case Iop_RSqrtStep32Fx2:
+  case Iop_RSqrtStep64Fx2:
+    mdMul(tmp, MDVAL(0), MDVAL(1), n);
+    mdSetD(constant, 3.0, n);
+    mdSub(tmp, constant, tmp, n);
+    mdMulD(res, tmp, 0.5, n);
+    break;
+  case Iop_Add64Fx4:
+  case Iop_Add64Fx2:
+  case Iop_Add64F0x2:
+  case Iop_Add32F0x4:
+  case Iop_Add32Fx2:
+  case Iop_Add32Fx4:
+  case Iop_Add32Fx8:
+  case Iop_AddF128:
+  case Iop_AddF64:
+  case Iop_AddF32:
+  case Iop_AddF64r32:
+    mdAdd(res, MDVAL(0), MDVAL(1), n);
+    break;
+  case Iop_Sub64F0x2:
+  case Iop_Sub32F0x4:
+  case Iop_Sub32Fx2:
+  case Iop_Sub32Fx8:
+  case Iop_Sub64Fx4:
+  case Iop_Sub32Fx4:
+  case Iop_Sub64Fx2:
+  case Iop_SubF128:
+  case Iop_SubF32:
+  case Iop_SubF64:
+  case Iop_SubF64r32:
+    mdSub(res, MDVAL(0), MDVAL(1), n);
+    break;
+  case Iop_Mul32F0x4:
+  case Iop_Mul64F0x2:
+  case Iop_Mul32Fx8:
+  case Iop_Mul64Fx4:
+  case Iop_Mul32Fx4:
+  case Iop_Mul64Fx2:
+  case Iop_MulF128:
+  case Iop_MulF64:
+  case Iop_MulF32:
+  case Iop_MulF64r32:
+    mdMul(res, MDVAL(0), MDVAL(1), n);
+    break;
+  case Iop_Div32F0x4:
+  case Iop_Div64F0x2:
+  case Iop_Div32Fx8:
+  case Iop_Div64Fx4:
+  case Iop_Div32Fx4:
+  case Iop_DivF128:
+  case Iop_DivF64:
+  case Iop_DivF32:
+  case Iop_DivF64r32:
+  case Iop_Div64Fx2:
+    if (mdGetD(MDVAL(1), n) != 0.0){
+      mdDiv(res, MDVAL(0), MDVAL(1), n);
+    } else {
+      mdSetD(res, NAN, n);
+    }
+    break;
+  case Iop_Max64F0x2:
+  case Iop_Max64Fx2:
+  case Iop_Max32F0x4:
+  case Iop_Max32Fx4:
+  case Iop_Max32Fx2:
+    if (mdCmp(MDVAL(0), MDVAL(1), n) > 0){
+      mdCopy(res, MDVAL(0), n);
+    } else {
+      mdCopy(res, MDVAL(1), n);
+    }
+    break;
+  case Iop_Min64F0x2:
+  case Iop_Min64Fx2:
+  case Iop_Min32F0x4:
+  case Iop_Min32Fx4:
+  case Iop_Min32Fx2:
+    if (mdCmp(MDVAL(0), MDVAL(1), n) < 0){
+      mdCopy(res, MDVAL(0), n);
+    } else {
+      mdCopy(res, MDVAL(1), n);
+    }
+    break;
+  case Iop_MAddF32:
+  case Iop_MAddF64:
+  case Iop_MAddF64r32:
+    mdFma(res, MDVAL(0), MDVAL(1), MDVAL(2), n);
+    break;
+  case Iop_MSubF32:
+  case Iop_MSubF64:
+  case Iop_MSubF64r32:
+    mdNeg(tmp, MDVAL(2), n);
+    mdFma(res, MDVAL(0), MDVAL(1), tmp, n);
+    break;
+  case Iop_SinF64:
+  case Iop_CosF64:
+  case Iop_TanF64:
+  case Iop_2xm1F64:
+  case Iop_RecpExpF64:
+  case Iop_RecpExpF32:
+    execRealOpInMPFR(op_code, result, args, 1);
+    break;
+  case Iop_AtanF64:
+  case Iop_Yl2xF64:
+  case Iop_Yl2xp1F64:
+  case Iop_ScaleF64:
+    execRealOpInMPFR(op_code, result, args, 2);
+    break;
+  default:
+    VG_(printf)("Don't recognize (%u) ", op_code);
+    ppIROp_Extended(op_code);
+    VG_(printf)("\n");
+    tl_assert(0);
+    return;
+  }
+}
+
+static void execMPFRRealOp(IROp op_code, Real* result, ShadowValue** args){
   switch((int)op_code){
   case Iop_RecipEst32Fx4:
   case Iop_RecipEst32Fx2:
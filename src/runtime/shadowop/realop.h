@@ -76,6 +76,14 @@
 #endif
 
 void execRealOp(IROp op_code, Real* result, ShadowValue** args);
+// If every argument is exactly a double, and the op is a cheap one
+// whose result we can show is exactly a double too, set result to
+// that double and return True. Otherwise returns False, and the op
+// has to go through execRealOp.
+Bool execExactOp(IROp op_code, ShadowValue* result, ShadowValue** args);
+ShadowValue* getMPFRScratchResult(void);
+void loadMPFRScratchArgs(ShadowValue** scratchArgs,
+                         ShadowValue** args, int nargs);
 DEF1(recip);
 DEF2(recip_step);
 DEF2(recip_sqrt_step);
@@ -33,6 +33,7 @@
 #include "realop.h"
 #include "pub_tool_libcprint.h"
 #include "pub_tool_libcassert.h"
+#include "pub_tool_libcbase.h"
 #include "error.h"
 #include "symbolic-op.h"
 #include "local-op.h"
@@ -40,6 +41,42 @@
 #include "../../helper/ir-info.h"
 #include "../../helper/runtime-util.h"
 
+static Bool isPureZeroMul(ShadowOpInfo* opinfo, ShadowValue** args,
+                          double* clientArgs);
+static Bool canBatchLanes(void);
+static void executeLanesShadowOp(ShadowOpInfo* opinfo, int numLanes,
+                                 ShadowValue*** laneArgs,
+                                 double clientArgs[][4],
+                                 double* clientResults,
+                                 ShadowValue** laneResults);
+
+UWord shadowingActive = 1;
+// Starting at one makes the first block pick whether the first burst
+// is shadowed.
+ULong sampleCountdown = 1;
+ULong sampledBursts = 0;
+ULong totalBursts = 0;
+static UInt sampleSeed = 0x5eed;
+
+VG_REGPARM(0) void endSampleBurst(void){
+  // Compare against the whole word, since the low bits of
+  // VG_(random) are weak.
+  UInt draw = VG_(random)(&sampleSeed);
+  shadowingActive = draw < sample_rate * 4294967295.0;
+  totalBursts += 1;
+  if (shadowingActive){
+    sampledBursts += 1;
+  }
+  sampleCountdown = sample_burst;
+}
+
+double sampleScale(void){
+  if (!SAMPLING || sampledBursts == 0){
+    return 1.0;
+  }
+  return ((double)totalBursts) / sampledBursts;
+}
+
 VG_REGPARM(1) ShadowTemp* executeShadowOp(ShadowOpInfoInstance* infoInstance){
   ShadowOpInfo* opInfo = infoInstance->info;
   // Make sure the op code is sane, so that things don't go bonkers
@@ -59,7 +96,7 @@ VG_REGPARM(1) ShadowTemp* executeShadowOp(ShadowOpInfoInstance* infoInstance){
   int numChannels = numChannelsOut(opInfo->op_code);
   tl_assert(numChannels <= MAX_TEMP_BLOCKS);
   ShadowTemp* args[4];
-  double clientArgs[4][MAX_TEMP_BLOCKS];
+  double clientArgs[MAX_TEMP_BLOCKS][4];
   for(int i = 0; i < nargs; ++i){
     args[i] = getArg(i, opInfo->op_code, infoInstance->argTemps[i]);
     tl_assert2(INT(args[i]->num_blocks) == INT(numArgBlocks),
@@ -72,34 +109,50 @@ VG_REGPARM(1) ShadowTemp* executeShadowOp(ShadowOpInfoInstance* infoInstance){
         computedArgs.argValuesF[i][j];
     }
   }
-  // Do the operation on the operand channels
+  // Do the operation on the operand channels. Each lane takes up
+  // one block if it's single precision, and two if it's double.
   int numOperandChannels = numSIMDOperands(opInfo->op_code);
-  int numOperandBlocks =
-    numOperandChannels * (opArgPrecision(opInfo->op_code) == Vt_Double ? 2 : 1);
-  for(int i = 0; i < numOperandBlocks; ++i){
-    ShadowValue* vals[MAX_TEMP_BLOCKS];
-    ValueType argPrecision = opArgPrecision(opInfo->op_code);
-    if (argPrecision == Vt_Double && i % 2 == 1){
-      result->values[i] = NULL;
-      continue;
-    }
+  ValueType argPrecision = opArgPrecision(opInfo->op_code);
+  int laneBlocks = argPrecision == Vt_Double ? 2 : 1;
+  int numOperandBlocks = numOperandChannels * laneBlocks;
+  ShadowValue* laneVals[MAX_TEMP_BLOCKS][4];
+  ShadowValue** laneArgs[MAX_TEMP_BLOCKS];
+  double laneOutputs[MAX_TEMP_BLOCKS];
+  ShadowValue* laneResults[MAX_TEMP_BLOCKS];
+  for(int lane = 0; lane < numOperandChannels; ++lane){
+    int block = lane * laneBlocks;
     for(int j = 0; j < nargs; ++j){
-      if (args[j]->values[i] == NULL){
-        args[j]->values[i] = mkShadowValue(argPrecision, clientArgs[i][j]);
+      if (args[j]->values[block] == NULL){
+        args[j]->values[block] =
+          mkShadowValue(argPrecision, clientArgs[lane][j]);
+        args[j]->borrowed &= ~(1UL << block);
         if (PRINT_VALUE_MOVES){
           VG_(printf)("Making shadow value %p for argument %d block %d (%p) in t%d.\n",
-                      args[j]->values[j], j, i, args[j], infoInstance->argTemps[i]);
+                      args[j]->values[block], j, block, args[j],
+                      infoInstance->argTemps[j]);
         }
       }
-      vals[j] = args[j]->values[i];
+      laneVals[lane][j] = args[j]->values[block];
+    }
+    laneArgs[lane] = laneVals[lane];
+    laneOutputs[lane] = argPrecision == Vt_Single ?
+      computedResult.f[lane] : computedResult.d[lane];
+  }
+  if (numOperandChannels > 1 && canBatchLanes()){
+    executeLanesShadowOp(opInfo, numOperandChannels, laneArgs,
+                         clientArgs, laneOutputs, laneResults);
+  } else {
+    for(int lane = 0; lane < numOperandChannels; ++lane){
+      laneResults[lane] =
+        executeChannelShadowOp(opInfo, laneArgs[lane],
+                               clientArgs[lane], laneOutputs[lane]);
+    }
+  }
+  for(int lane = 0; lane < numOperandChannels; ++lane){
+    result->values[lane * laneBlocks] = laneResults[lane];
+    if (laneBlocks == 2){
+      result->values[lane * laneBlocks + 1] = NULL;
     }
-    double computedOutput = (argPrecision == Vt_Single ?
-       computedResult.f[i] : computedResult.d[i / 2]);
-    result->values[i] =
-      executeChannelShadowOp(opInfo,
-                             vals,
-                             clientArgs[i],
-                             computedOutput);
   }
   // Copy across argument on the non-operand channels
   for(int i = numOperandBlocks; i < INT(numBlocks); ++i){
@@ -150,6 +203,21 @@ VG_REGPARM(1) ShadowTemp* executeShadowOp(ShadowOpInfoInstance* infoInstance){
   }
   return result;
 }
+VG_REGPARM(1) void executeShadowProgram(ShadowProgram* program){
+  for(int i = 0; i < program->num_ops; ++i){
+    ShadowProgramOp* op = program->ops[i];
+    for(int j = 0; j < op->nargs; ++j){
+      VG_(memcpy)(computedArgs.argValues[j], op->args.argValues[j],
+                  sizeof(computedArgs.argValues[j]));
+    }
+    VG_(memcpy)(&computedResult, &(op->result), sizeof(ResultUnion));
+    shadowTemps[op->dest] = executeShadowOp(op->instance);
+    if (PRINT_TEMP_MOVES){
+      VG_(printf)("[program] storing %p in t%d\n",
+                  shadowTemps[op->dest], op->dest);
+    }
+  }
+}
 ShadowTemp* getArg(int argIdx, IROp op, IRTemp argTemp){
   if (argTemp == -1 ||
       shadowTemps[argTemp] == NULL){
@@ -199,6 +267,103 @@ void ppInfluenceAddrs(ShadowValue* val){
     }
   }
 }
+// A multiply where one side is zero in the client, and the other
+// isn't NaN in the reals, can't have any error. We don't want those
+// to show up as influences, or to cost us a real op.
+static Bool isPureZeroMul(ShadowOpInfo* opinfo, ShadowValue** args,
+                          double* clientArgs){
+  if (dont_ignore_pure_zeroes || no_reals){
+    return False;
+  }
+  switch((int)opinfo->op_code){
+  case Iop_Mul32F0x4:
+  case Iop_Mul64F0x2:
+  case Iop_Mul32Fx8:
+  case Iop_Mul64Fx4:
+  case Iop_Mul32Fx4:
+  case Iop_Mul64Fx2:
+  case Iop_MulF64:
+  case Iop_MulF128:
+  case Iop_MulF32:
+  case Iop_MulF64r32:
+    return (clientArgs[0] == 0 && !isNaN(args[1]->real)) ||
+      (clientArgs[1] == 0 && !isNaN(args[0]->real));
+  default:
+    return False;
+  }
+}
+
+// The batched lane path skips the per-lane debug printing, so only
+// take it when none of that is turned on.
+static Bool canBatchLanes(void){
+  return !no_reals && !print_inputs && !print_errors &&
+    !print_errors_long && !print_semantic_ops && !print_influences &&
+    !print_expr_refs;
+}
+
+// Run all the lanes of a packed SIMD op. This does the same thing as
+// running executeChannelShadowOp on each lane, but allocates the
+// results together, records their errors in the op's aggregate in
+// one go, and merges their expressions together (see
+// execSymbolicOpLanes). Packed ops have no compensation detection,
+// so that's skipped here.
+static void executeLanesShadowOp(ShadowOpInfo* opinfo, int numLanes,
+                                 ShadowValue*** laneArgs,
+                                 double clientArgs[][4],
+                                 double* clientResults,
+                                 ShadowValue** laneResults){
+  ValueType argPrecision = opArgPrecision(opinfo->op_code);
+  int nargs = numFloatArgs(opinfo);
+  int batchedLanes[MAX_TEMP_BLOCKS];
+  int numBatched = 0;
+  for(int lane = 0; lane < numLanes; ++lane){
+    if (isPureZeroMul(opinfo, laneArgs[lane], clientArgs[lane])){
+      laneResults[lane] =
+        executeChannelShadowOp(opinfo, laneArgs[lane],
+                               clientArgs[lane], clientResults[lane]);
+    } else {
+      batchedLanes[numBatched++] = lane;
+    }
+  }
+  if (numBatched == 0){
+    return;
+  }
+
+  ShadowValue* results[MAX_TEMP_BLOCKS];
+  ShadowValue** args[MAX_TEMP_BLOCKS];
+  double outputs[MAX_TEMP_BLOCKS];
+  double localErrors[MAX_TEMP_BLOCKS];
+  double globalErrors[MAX_TEMP_BLOCKS];
+  Bool problematic[MAX_TEMP_BLOCKS];
+  mkShadowValuesBare(argPrecision, numBatched, results);
+  for(int i = 0; i < numBatched; ++i){
+    int lane = batchedLanes[i];
+    args[i] = laneArgs[lane];
+    outputs[i] = clientResults[lane];
+    if (!execExactOp(opinfo->op_code, results[i], args[i])){
+      execRealOp(opinfo->op_code, &(results[i]->real), args[i]);
+    }
+    if (use_ranges){
+      updateRanges(opinfo->agg.inputs.range_records,
+                   clientArgs[lane], nargs);
+    }
+    measureOpErrors(opinfo, results[i], args[i], outputs[i],
+                    &(localErrors[i]), &(globalErrors[i]));
+    problematic[i] = globalErrors[i] > error_threshold;
+    laneResults[lane] = results[i];
+  }
+  if (!no_reals){
+    addErrors(&(opinfo->agg.local_error), localErrors, numBatched);
+    addErrors(&(opinfo->agg.global_error), globalErrors, numBatched);
+  }
+  execSymbolicOpLanes(opinfo, numBatched, results, outputs, args,
+                      problematic);
+  for(int i = 0; i < numBatched; ++i){
+    execInfluencesOp(opinfo, &(results[i]->influences), args[i],
+                     localErrors[i] >= error_threshold);
+  }
+}
+
 ShadowValue* executeChannelShadowOp(ShadowOpInfo* opinfo,
                                     ShadowValue** args,
                                     double* clientArgs,
@@ -214,73 +379,60 @@ ShadowValue* executeChannelShadowOp(ShadowOpInfo* opinfo,
   // that instruction.
   ValueType argPrecision = opArgPrecision(opinfo->op_code);
   int nargs = numFloatArgs(opinfo);
-  if (!dont_ignore_pure_zeroes && !no_reals){
-    switch((int)opinfo->op_code){
-    case Iop_Mul32F0x4:
-    case Iop_Mul64F0x2:
-    case Iop_Mul32Fx8:
-    case Iop_Mul64Fx4:
-    case Iop_Mul32Fx4:
-    case Iop_Mul64Fx2:
-    case Iop_MulF64:
-    case Iop_MulF128:
-    case Iop_MulF32:
-    case Iop_MulF64r32:
-      if ((clientArgs[0] == 0 && !isNaN(args[1]->real)) ||
-          (clientArgs[1] == 0 && !isNaN(args[0]->real))){
-        if (print_influences){
-          if (clientArgs[0] == 0 && !isNaN(args[1]->real)){
-            VG_(printf)("Not propagating influences because arg 0 is zero (client val ");
-            ppFloat(clientArgs[0]);
-            VG_(printf)(")\n");
-          } else {
-            VG_(printf)("Not propagating influences because arg 1 is zero (client val ");
-            ppFloat(clientArgs[1]);
-            VG_(printf)(")\n");
-          }
-        }
-        ShadowValue* result =
-          mkShadowValue(argPrecision, clientResult);
-        if (use_ranges){
-          updateRanges(opinfo->agg.inputs.range_records, clientArgs, nargs);
-        }
-        execSymbolicOp(opinfo, &(result->expr), clientResult, args, False);
-        return result;
+  if (isPureZeroMul(opinfo, args, clientArgs)){
+    if (print_influences){
+      if (clientArgs[0] == 0 && !isNaN(args[1]->real)){
+        VG_(printf)("Not propagating influences because arg 0 is zero (client val ");
+        ppFloat(clientArgs[0]);
+        VG_(printf)(")\n");
+      } else {
+        VG_(printf)("Not propagating influences because arg 1 is zero (client val ");
+        ppFloat(clientArgs[1]);
+        VG_(printf)(")\n");
       }
-      break;
-    default:
-      break;
     }
+    ShadowValue* result =
+      mkShadowValue(argPrecision, clientResult);
+    if (use_ranges){
+      updateRanges(opinfo->agg.inputs.range_records, clientArgs, nargs);
+    }
+    execSymbolicOp(opinfo, &(result->expr), clientResult, args, False);
+    return result;
   }
   if (print_inputs){
     for(int i = 0; i < nargs; ++i){
       VG_(printf)("Arg %d is computed as ", i + 1);
       ppFloat(clientArgs[i]);
       VG_(printf)(", and is shadowed as ");
-      ppFloat(getDouble(args[i]->real));
+      ppFloat(getValDouble(args[i]));
       VG_(printf)("\n");
     }
   }
   ShadowValue* result = mkShadowValueBare(argPrecision);
-  execRealOp(opinfo->op_code, &(result->real), args);
+  if (!execExactOp(opinfo->op_code, result, args)){
+    execRealOp(opinfo->op_code, &(result->real), args);
+  }
   if (use_ranges){
     updateRanges(opinfo->agg.inputs.range_records, clientArgs, nargs);
   }
 
+  double bitsLocalError, bitsGlobalError;
   if (print_errors_long || print_errors){
     printOpInfo(opinfo);
     VG_(printf)(":\n");
-  }
-  if (print_errors_long || print_errors){
     VG_(printf)("Local:\n");
-  }
-  double bitsLocalError =
-    execLocalOp(opinfo, result->real, result, args);
-  if (print_errors_long || print_errors){
+    bitsLocalError = execLocalOp(opinfo, result, args);
     VG_(printf)("Global:\n");
+    bitsGlobalError =
+      updateError(&(opinfo->agg.global_error), result, clientResult);
+  } else {
+    measureOpErrors(opinfo, result, args, clientResult,
+                    &bitsLocalError, &bitsGlobalError);
+    if (!no_reals){
+      addErrors(&(opinfo->agg.local_error), &bitsLocalError, 1);
+      addErrors(&(opinfo->agg.global_error), &bitsGlobalError, 1);
+    }
   }
-  double bitsGlobalError =
-    updateError(&(opinfo->agg.global_error), result->real, clientResult);
   execSymbolicOp(opinfo, &(result->expr), clientResult, args,
                  bitsGlobalError > error_threshold);
   if (print_expr_refs){
@@ -311,9 +463,9 @@ ShadowValue* executeChannelShadowOp(ShadowOpInfo* opinfo,
     case Iop_Add64F0x2:
     case Iop_AddF64:
     case Iop_AddF32:
-      if (getDouble(args[0]->real) == 0){
-        ULong inputError = ulpd(getDouble(args[1]->real), clientArgs[1]);
-        ULong outputError = ulpd(getDouble(result->real), clientResult);
+      if (getValDouble(args[0]) == 0){
+        ULong inputError = ulpd(getValDouble(args[1]), clientArgs[1]);
+        ULong outputError = ulpd(getValDouble(result), clientResult);
         if (outputError <= inputError){
           result->influences = cloneInfluences(args[1]->influences);
           return result;
@@ -328,9 +480,9 @@ ShadowValue* executeChannelShadowOp(ShadowOpInfo* opinfo,
     case Iop_Sub64F0x2:
     case Iop_SubF64:
     case Iop_SubF32:
-      if (getDouble(args[1]->real) == 0){
-        ULong inputError = ulpd(getDouble(args[0]->real), clientArgs[0]);
-        ULong outputError = ulpd(getDouble(result->real), clientResult);
+      if (getValDouble(args[1]) == 0){
+        ULong inputError = ulpd(getValDouble(args[0]), clientArgs[0]);
+        ULong outputError = ulpd(getValDouble(result), clientResult);
         if (outputError <= inputError){
           result->influences = cloneInfluences(args[0]->influences);
           return result;
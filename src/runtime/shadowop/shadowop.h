@@ -34,9 +34,44 @@
 #include "pub_tool_tooliface.h"
 #include "pub_tool_xarray.h"
 #include "../value-shadowstate/shadowval.h"
+#include "../value-shadowstate/value-shadowstate.h"
 #include "../op-shadowstate/shadowop-info.h"
 
+// Sampling state, used when --sample-rate is below one. Execution is
+// cut into bursts of --sample-burst blocks, and each burst is
+// shadowed with probability sample_rate. The instrumentation reads
+// shadowingActive before running an op, and counts sampleCountdown
+// down once per block, calling endSampleBurst when it hits zero.
+extern UWord shadowingActive;
+extern ULong sampleCountdown;
+extern ULong sampledBursts;
+extern ULong totalBursts;
+VG_REGPARM(0) void endSampleBurst(void);
+// The factor to scale sampled execution counts by to estimate how
+// many times they really ran.
+double sampleScale(void);
+
 VG_REGPARM(1) ShadowTemp* executeShadowOp(ShadowOpInfoInstance* instance);
+
+// A run of a block's shadow ops, executed together by a single call
+// to executeShadowProgram instead of one executeShadowOp call
+// apiece. Since the ops don't run where they are in the block, each
+// one gets its own copy of the client arguments and result, which
+// are loaded into computedArgs and computedResult before it runs.
+typedef struct _ShadowProgramOp {
+  ShadowOpInfoInstance* instance;
+  IRTemp dest;
+  int nargs;
+  ArgUnion args;
+  ResultUnion result;
+} ShadowProgramOp;
+
+typedef struct _ShadowProgram {
+  int num_ops;
+  ShadowProgramOp** ops;
+} ShadowProgram;
+
+VG_REGPARM(1) void executeShadowProgram(ShadowProgram* program);
 ShadowTemp* getArg(int argIdx, IROp op, IRTemp argTemp);
 ShadowValue* executeChannelShadowOp(ShadowOpInfo* opinfo,
                                     ShadowValue** args,
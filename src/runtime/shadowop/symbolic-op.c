@@ -36,6 +36,22 @@
 #include "../../helper/runtime-util.h"
 
 #define GENERALIZE_DEPTH 2
+// Once merging into an op's symbolic expression has left it alone
+// this many times in a row, we call it converged, and stop merging
+// into it. Instead, every CONVERGED_CHECK_PERIOD executions we check
+// that the new concrete expression still fits, and go back to
+// merging if it doesn't. Executions with a problematic result are
+// always checked, since their ranges get folded into the symbolic
+// expression's range table, which only works if the concrete
+// expression fits it.
+#define CONVERGED_MERGES 256
+#define CONVERGED_CHECK_PERIOD 64
+
+static Bool skipConvergedMerge(ShadowOpInfo* opinfo, ConcExpr* cexpr,
+                               Bool problematic);
+static Bool symbExprCovers(SymbExpr* symbExpr, ConcExpr* concExpr);
+static void flattenForMerge(SymbExpr* symbExpr, ConcExpr* concExpr);
+int numTrackedNodes(GroupList glist);
 
 void execSymbolicOp(ShadowOpInfo* opinfo, ConcExpr** result,
                     double computedResult, ShadowValue** args,
@@ -50,15 +66,183 @@ void execSymbolicOp(ShadowOpInfo* opinfo, ConcExpr** result,
   }
   *result = mkBranchConcExpr(computedResult, opinfo,
                              nargs, exprArgs);
-  generalizeSymbolicExpr(&(opinfo->expr), *result);
+  if (!skipConvergedMerge(opinfo, *result, problematic)){
+    if (generalizeSymbolicExpr(&(opinfo->expr), *result)){
+      opinfo->stable_merges = 0;
+    } else {
+      opinfo->stable_merges++;
+    }
+  }
   if (problematic){
     updateProblematicRanges(opinfo->expr, *result);
   }
 }
 
-void generalizeSymbolicExpr(SymbExpr** symbexpr, ConcExpr* cexpr){
+// The lanes of a packed op almost always compute the same expression
+// on different data, so once the first lane has been merged in, the
+// rest usually leave the symbolic expression as it is. We only check
+// that they do, which doesn't allocate, and merge the ones that
+// don't.
+void execSymbolicOpLanes(ShadowOpInfo* opinfo, int numLanes,
+                         ShadowValue** results, double* computedResults,
+                         ShadowValue*** laneArgs, Bool* problematic){
+  if (no_exprs){
+    return;
+  }
+  int nargs = numFloatArgs(opinfo);
+  for(int lane = 0; lane < numLanes; ++lane){
+    ConcExpr* exprArgs[MAX_BRANCH_ARGS];
+    for(int i = 0; i < nargs; ++i){
+      exprArgs[i] = laneArgs[lane][i]->expr;
+    }
+    ConcExpr* cexpr = mkBranchConcExpr(computedResults[lane], opinfo,
+                                       nargs, exprArgs);
+    results[lane]->expr = cexpr;
+    Bool shouldMerge;
+    if (lane == 0 || opinfo->expr == NULL){
+      shouldMerge = !skipConvergedMerge(opinfo, cexpr, problematic[lane]);
+    } else {
+      shouldMerge = !symbExprCovers(opinfo->expr, cexpr);
+    }
+    if (shouldMerge){
+      if (generalizeSymbolicExpr(&(opinfo->expr), cexpr)){
+        opinfo->stable_merges = 0;
+      } else {
+        opinfo->stable_merges++;
+      }
+    }
+    if (problematic[lane]){
+      updateProblematicRanges(opinfo->expr, cexpr);
+    }
+  }
+}
+
+static Bool skipConvergedMerge(ShadowOpInfo* opinfo, ConcExpr* cexpr,
+                               Bool problematic){
+  if (opinfo->stable_merges < CONVERGED_MERGES){
+    return False;
+  }
+  if ((problematic ||
+       (opinfo->skipped_merges + 1) % CONVERGED_CHECK_PERIOD == 0) &&
+      !symbExprCovers(opinfo->expr, cexpr)){
+    opinfo->stable_merges = 0;
+    return False;
+  }
+  opinfo->skipped_merges++;
+  return True;
+}
+
+// Check, without changing anything, whether merging concExpr into
+// symbExpr would leave it as it is. This follows what
+// generalizeStructure and intersectEqualities would do, but only
+// reads.
+static Bool structureCovers(SymbExpr* symbExpr, ConcExpr* concExpr,
+                            int depth){
+  if (depth == 0){
+    return True;
+  }
+  if (symbExpr->isConst){
+    if (symbExpr->constVal != symbExpr->constVal){
+      if (concExpr->value == concExpr->value){
+        return False;
+      }
+    } else if (symbExpr->constVal != concExpr->value &&
+               concExpr->value == concExpr->value){
+      return False;
+    }
+  }
+  if (symbExpr->type == Node_Leaf){
+    return True;
+  }
+  for(int i = 0; i < symbExpr->branch.nargs; ++i){
+    SymbExpr* symbChild = symbExpr->branch.args[i];
+    ConcExpr* concChild = concExpr->branch.args[i];
+    if (symbChild->type == Node_Branch &&
+        (concChild->type == Node_Leaf ||
+         concChild->branch.op != symbChild->branch.op)){
+      return False;
+    }
+    if (!structureCovers(symbChild, concChild, depth - 1)){
+      return False;
+    }
+  }
+  return True;
+}
+// The symbolic expression being merged into, and the concrete
+// expression being merged, laid out by the symbolic expression's
+// position index (see buildPosIndex), so that group members can be
+// looked up without walking either tree. These get reused from call
+// to call.
+static SymbExpr** flatSymb = NULL;
+static ConcExpr** flatConc = NULL;
+static int flatCapacity = 0;
+static void flattenForMerge(SymbExpr* symbExpr, ConcExpr* concExpr){
+  int numNodes = symbExpr->branch.posIndex.numNodes;
+  if (flatCapacity < numNodes){
+    if (flatSymb != NULL){
+      VG_(free)(flatSymb);
+      VG_(free)(flatConc);
+    }
+    flatSymb = VG_(malloc)("flattened symbolic expr",
+                           sizeof(SymbExpr*) * numNodes);
+    flatConc = VG_(malloc)("flattened concrete expr",
+                           sizeof(ConcExpr*) * numNodes);
+    flatCapacity = numNodes;
+  }
+  flattenSymbExpr(symbExpr, flatSymb);
+  flattenConcExpr(symbExpr, concExpr, flatConc);
+}
+static Bool symbExprCovers(SymbExpr* symbExpr, ConcExpr* concExpr){
+  if (symbExpr->type == Node_Branch &&
+      (concExpr->type == Node_Leaf ||
+       concExpr->branch.op != symbExpr->branch.op)){
+    return False;
+  }
+  if (!structureCovers(symbExpr, concExpr, GENERALIZE_DEPTH)){
+    return False;
+  }
+  if (symbExpr->type == Node_Leaf){
+    return True;
+  }
+  GroupList groups = symbExpr->branch.groups;
+  if (groups->size == 0){
+    return True;
+  }
+  flattenForMerge(symbExpr, concExpr);
+  for(int i = 0; i < groups->size; ++i){
+    Group curGroup = groups->data[i];
+    double canonicalValue = 0.0;
+    for(Group curNode = curGroup; curNode != NULL; curNode = curNode->next){
+      int idx = posIndexOf(symbExpr, curNode->item);
+      if (idx == -1 || flatSymb[idx] == NULL){
+        return False;
+      }
+      ConcExpr* member = flatConc[idx];
+      if (member == NULL){
+        return False;
+      }
+      if (curNode == curGroup){
+        canonicalValue = member->value;
+      } else if (!NaNSafeEquals(member->value, canonicalValue)){
+        return False;
+      }
+    }
+  }
+  return True;
+}
+
+Bool generalizeSymbolicExpr(SymbExpr** symbexpr, ConcExpr* cexpr){
+  Bool changed = False;
+  // Generalizing is idempotent, so if this node was the last thing
+  // merged into this expression, there's nothing left to do. This
+  // comes up a lot with --hashcons-exprs, where a loop keeps handing
+  // us the same node.
+  if (*symbexpr != NULL && cexpr->merged_into == *symbexpr){
+    return False;
+  }
   if (*symbexpr == NULL){
     *symbexpr = concreteToSymbolic(cexpr);
+    changed = True;
     if (print_expr_updates){
       VG_(printf)("Created expression %p ", *symbexpr);
       ppSymbExpr(*symbexpr);
@@ -79,18 +263,32 @@ void generalizeSymbolicExpr(SymbExpr** symbexpr, ConcExpr* cexpr){
         mkFreshSymbolicLeaf((*symbexpr)->isConst &&
                             (*symbexpr)->constVal == cexpr->value,
                             (*symbexpr)->constVal);
+      changed = True;
     } else {
       if ((*symbexpr)->isConst){
         if ((*symbexpr)->constVal != (*symbexpr)->constVal){
           (*symbexpr)->constVal = cexpr->value;
+          changed = True;
         } else if (!NaNSafeEquals((*symbexpr)->constVal, cexpr->value) &&
                    cexpr->value == cexpr->value){
           (*symbexpr)->isConst = False;
+          changed = True;
         }
       }
-      generalizeStructure(*symbexpr, cexpr, GENERALIZE_DEPTH);
+      if (generalizeStructure(*symbexpr, cexpr, GENERALIZE_DEPTH)){
+        changed = True;
+      }
       if ((*symbexpr)->type == Node_Branch){
+        // Groups only ever split or lose members, so if there are as
+        // many groups covering as many nodes as before, nothing
+        // changed.
+        int oldNumGroups = (*symbexpr)->branch.groups->size;
+        int oldNumTracked = numTrackedNodes((*symbexpr)->branch.groups);
         intersectEqualities(*symbexpr, cexpr);
+        if ((*symbexpr)->branch.groups->size != oldNumGroups ||
+            numTrackedNodes((*symbexpr)->branch.groups) != oldNumTracked){
+          changed = True;
+        }
       }
     }
     if (print_expr_updates){
@@ -99,54 +297,108 @@ void generalizeSymbolicExpr(SymbExpr** symbexpr, ConcExpr* cexpr){
       VG_(printf)("\n");
     }
   }
+  cexpr->merged_into = *symbexpr;
+  return changed;
 }
 
-void addValEntry(VgHashTable* valmap, double val, int groupIdx){
-  ValMapEntry* entry = VG_(malloc)("val map entry", sizeof(ValMapEntry));
-  entry->valHash = hashValue(val);
-  entry->val = val;
-  entry->groupIdx = groupIdx;
-  VG_(HT_add_node)(valmap, entry);
+// Grouping nodes by value, and deduplicating positions, both need a
+// set keyed by a word. Rather than build and tear down a hash table
+// every time, they share this open-addressed table, which is kept
+// around between calls and emptied by bumping scratchGen, so that in
+// the steady state they don't allocate at all.
+typedef struct _scratchSlot {
+  UWord key;
+  UInt gen;
+  int idx;
+} ScratchSlot;
+static ScratchSlot* scratchTable = NULL;
+static UWord scratchCapacity = 0;
+static UWord scratchCount = 0;
+static UInt scratchGen = 0;
+#define INITIAL_SCRATCH_CAPACITY 64
+
+static void clearScratchTable(void){
+  scratchGen++;
+  scratchCount = 0;
+  if (scratchGen == 0){
+    // The generation wrapped around, so stale slots might look live.
+    VG_(memset)(scratchTable, 0, scratchCapacity * sizeof(ScratchSlot));
+    scratchGen = 1;
+  }
 }
-int lookupVal(VgHashTable* valmap, double val){
-  ValMapEntry key = {.val = val,
-                     .valHash = hashValue(val)};
-  ValMapEntry* entry = VG_(HT_gen_lookup)(valmap, &key, cmp_value);
-  if (entry == NULL){
-    return -1;
-  } else {
-    return entry->groupIdx;
+static ScratchSlot* scratchSlotFor(ScratchSlot* table, UWord capacity,
+                                   UWord key){
+  UWord slotIdx = (key * 0x9E3779B97F4A7C15ULL) >> 32;
+  for(;; ++slotIdx){
+    ScratchSlot* slot = &(table[slotIdx & (capacity - 1)]);
+    if (slot->gen != scratchGen || slot->key == key){
+      return slot;
+    }
   }
 }
-UWord hashValue(double val){
-  return *(UWord*)&val;
+static void growScratchTable(void){
+  UWord newCapacity =
+    scratchCapacity == 0 ? INITIAL_SCRATCH_CAPACITY : scratchCapacity * 2;
+  ScratchSlot* newTable =
+    VG_(calloc)("symbolic scratch table", newCapacity, sizeof(ScratchSlot));
+  for(UWord i = 0; i < scratchCapacity; ++i){
+    if (scratchTable[i].gen == scratchGen){
+      *scratchSlotFor(newTable, newCapacity, scratchTable[i].key) =
+        scratchTable[i];
+    }
+  }
+  if (scratchTable != NULL){
+    VG_(free)(scratchTable);
+  }
+  scratchTable = newTable;
+  scratchCapacity = newCapacity;
 }
-Word cmp_value(const void* node1, const void* node2){
-  const ValMapEntry* entry1 = (const ValMapEntry*)node1;
-  const ValMapEntry* entry2 = (const ValMapEntry*)node2;
-  if (entry1->val == entry2->val){
-    return 0;
-  } else {
-    return 1;
+// Returns the index stored under key, or, if there isn't one yet,
+// stores idx under it and returns -1.
+static int scratchLookupOrAdd(UWord key, int idx){
+  if ((scratchCount + 1) * 2 > scratchCapacity){
+    growScratchTable();
   }
+  ScratchSlot* slot = scratchSlotFor(scratchTable, scratchCapacity, key);
+  if (slot->gen == scratchGen){
+    return slot->idx;
+  }
+  slot->key = key;
+  slot->gen = scratchGen;
+  slot->idx = idx;
+  scratchCount++;
+  return -1;
+}
+// NaN's never group with anything, not even other NaN's.
+static int lookupOrAddVal(double val, int groupIdx){
+  if (val != val){
+    return -1;
+  }
+  return scratchLookupOrAdd(hashValue(val), groupIdx);
 }
 
-void generalizeStructure(SymbExpr* symbExpr, ConcExpr* concExpr,
+UWord hashValue(double val){
+  return *(UWord*)&val;
+}
+Bool generalizeStructure(SymbExpr* symbExpr, ConcExpr* concExpr,
                          int depth){
+  Bool changed = False;
   if (depth == 0){
-    return;
+    return False;
   }
   if (symbExpr->isConst){
     // NaN constants defer to whatever they generalize with
     if (symbExpr->constVal != symbExpr->constVal){
       symbExpr->constVal = concExpr->value;
+      changed = changed || concExpr->value == concExpr->value;
     } else if (symbExpr->constVal != concExpr->value &&
                concExpr->value == concExpr->value){
       symbExpr->isConst = False;
+      changed = True;
     }
   }
   if (symbExpr->type == Node_Leaf){
-    return;
+    return changed;
   }
 
   tl_assert(symbExpr->type == Node_Branch);
@@ -165,72 +417,79 @@ void generalizeStructure(SymbExpr* symbExpr, ConcExpr* concExpr,
         if (!generalize_to_constant){
           symbChild->isConst = False;
         }
+        changed = True;
       }
     }
-    generalizeStructure(symbChild, concChild, depth - 1);
+    if (generalizeStructure(symbChild, concChild, depth - 1)){
+      changed = True;
+    }
   }
+  return changed;
 }
 
+// Split each group by the values its members have in concExpr. The
+// nodes of the old groups are moved straight into the new ones, and
+// the new groups are collected in a scratch list that's reused from
+// call to call, so once things have warmed up this doesn't allocate
+// unless a group actually splits.
 void intersectEqualities(SymbExpr* symbExpr, ConcExpr* concExpr){
+  static GroupList newGroups = NULL;
   tl_assert(concExpr->type == Node_Branch);
   tl_assert(symbExpr->type == Node_Branch);
+  if (newGroups == NULL){
+    newGroups = mkXA(GroupList)();
+  }
+  newGroups->size = 0;
   GroupList groups = symbExpr->branch.groups;
-  GroupList newGroups = mkXA(GroupList)();
+  if (groups->size == 0){
+    return;
+  }
+  flattenForMerge(symbExpr, concExpr);
   for(int i = 0; i < groups->size; i++){
     Group curGroup = groups->data[i];
     NodePos canonicalPos = curGroup->item;
     Group newCurGroup = NULL;
 
     double canonicalValue = 0.0;
-    VgHashTable* splitMap = NULL;
+    clearScratchTable();
 
     while(curGroup != NULL){
       NodePos groupMemberPos = lpop(Group)(&curGroup);
-      if (symbExprPosGet(symbExpr, groupMemberPos) == NULL){
+      int memberIdx = posIndexOf(symbExpr, groupMemberPos);
+      if (memberIdx == -1 || flatSymb[memberIdx] == NULL){
         if (newCurGroup == NULL){
           if (curGroup == NULL){
             break;
           }
-          RangeRecord* existingRange =
-            lookupRangeRecord(symbExpr->branch.varProblematicRanges,
-                              canonicalPos);
-          addRangeEntryCopy(symbExpr->branch.varProblematicRanges,
-                            curGroup->item, existingRange);
-          addExampleEntryCopy(symbExpr->branch.exampleProblematicArgs,
-                              curGroup->item,
-                              lookupExampleInput(symbExpr->branch.exampleProblematicArgs,
-                                                 canonicalPos));
+          RangeRecord existingRange;
+          Bool foundRange =
+            lookupRangeRecord(symbExpr, canonicalPos, &existingRange);
+          tl_assert(foundRange);
+          addRangeEntryCopy(symbExpr, curGroup->item, &existingRange);
+          addExampleEntryCopy(symbExpr, curGroup->item,
+                              lookupExampleInput(symbExpr, canonicalPos));
           canonicalPos = curGroup->item;
         }
         continue;
       }
-      double nodeValue = concExprPosGet(concExpr, groupMemberPos)->value;
+      double nodeValue = flatConc[memberIdx]->value;
       if (newCurGroup == NULL){
         canonicalValue = nodeValue;
         lpush(Group)(&(newCurGroup), groupMemberPos);
       } else {
         if (!NaNSafeEquals(nodeValue, canonicalValue)){
-          if (splitMap == NULL){
-            splitMap = VG_(HT_construct)("split map.\n");
-          }
-          int splitGroup = lookupVal(splitMap, nodeValue);
+          int splitGroup = lookupOrAddVal(nodeValue, newGroups->size);
           if (splitGroup == -1){
             Group newSplitGroup = NULL;
             lpush(Group)(&newSplitGroup, groupMemberPos);
-            addValEntry(splitMap, nodeValue, newGroups->size);
             XApush(GroupList)(newGroups, newSplitGroup);
-            RangeRecord* existingRange =
-              lookupRangeRecord(symbExpr->branch.varProblematicRanges,
-                                canonicalPos);
-            tl_assert(existingRange != NULL);
-            addRangeEntryCopy(symbExpr->branch.varProblematicRanges,
-                              groupMemberPos,
-                              existingRange);
-            addExampleEntryCopy(symbExpr->branch.exampleProblematicArgs,
-                                groupMemberPos,
-                                lookupExampleInput(symbExpr->branch
-                                                   .exampleProblematicArgs,
-                                                   canonicalPos));
+            RangeRecord existingRange;
+            Bool foundRange =
+              lookupRangeRecord(symbExpr, canonicalPos, &existingRange);
+            tl_assert(foundRange);
+            addRangeEntryCopy(symbExpr, groupMemberPos, &existingRange);
+            addExampleEntryCopy(symbExpr, groupMemberPos,
+                                lookupExampleInput(symbExpr, canonicalPos));
           } else {
             lpush(Group)(&(newGroups->data[splitGroup]), groupMemberPos);
           }
@@ -239,19 +498,35 @@ void intersectEqualities(SymbExpr* symbExpr, ConcExpr* concExpr){
         }
       }
     }
-    if (splitMap != NULL){
-      VG_(HT_destruct)(splitMap, VG_(free));
-    }
     XApush(GroupList)(newGroups, newCurGroup);
   }
-  freeXA(GroupList)(symbExpr->branch.groups);
-  symbExpr->branch.groups = pruneSingletonGroups(newGroups);
+  // The groups above were built backwards, so flip them back around
+  // as we copy them over, dropping the ones that are down to a single
+  // member. Group members are unique going in, so there's nothing to
+  // dedup.
+  groups->size = 0;
+  for(int i = 0; i < newGroups->size; ++i){
+    Group newGroup = newGroups->data[i];
+    if (newGroup == NULL){
+      continue;
+    }
+    if (newGroup->next == NULL){
+      lfree(Group)(&newGroup);
+      continue;
+    }
+    Group flipped = NULL;
+    while(newGroup != NULL){
+      lpush(Group)(&flipped, lpop(Group)(&newGroup));
+    }
+    XApush(GroupList)(groups, flipped);
+  }
 }
 
-void getGrouped(GroupList groupList, VgHashTable* valMap,
+void getGrouped(GroupList groupList,
                 ConcExpr* concExpr, SymbExpr* symbExpr,
                 NodePos curPos, int maxDepth);
-void getGrouped(GroupList groupList, VgHashTable* valMap,
+// Relies on the scratch table having been cleared by the caller.
+void getGrouped(GroupList groupList,
                 ConcExpr* concExpr, SymbExpr* symbExpr,
                 NodePos curPos, int maxDepth){
   tl_assert(symbExpr->type == Node_Branch);
@@ -264,11 +539,10 @@ void getGrouped(GroupList groupList, VgHashTable* valMap,
     double value = concChild->value;
 
     int existingEntry =
-      lookupVal(valMap, value);
+      lookupOrAddVal(value, groupList->size);
     int groupIdx;
     if (existingEntry == -1){
       groupIdx = groupList->size;
-      addValEntry(valMap, value, groupIdx);
       Group newGroup = NULL;
       XApush(GroupList)(groupList, newGroup);
     } else {
@@ -281,7 +555,7 @@ void getGrouped(GroupList groupList, VgHashTable* valMap,
         symbChild->type == Node_Branch &&
         concChild->branch.op == symbChild->branch.op){
       if (maxDepth > 1){
-        getGrouped(groupList, valMap, concChild, symbChild, newPos, maxDepth - 1);
+        getGrouped(groupList, concChild, symbChild, newPos, maxDepth - 1);
       } else {
         for(int j = 0; j < symbChild->branch.groups->size; ++j){
           Group oldGroup = symbChild->branch.groups->data[j];
@@ -309,31 +583,30 @@ GroupList pruneSingletonGroups(GroupList _list){
     if (list->data[i] != NULL){
       if (list->data[i]->next != NULL){
         XApush(GroupList)(newGroupList, list->data[i]);
+      } else {
+        lfree(Group)(&(list->data[i]));
       }
     }
   }
   freeXA(GroupList)(list);
   return newGroupList;
 }
+// Remove repeated positions from each group, in place. Positions are
+// interned, so the scratch table can key on their addresses. Like
+// building the group up with lpush, this reverses each group.
 GroupList dedupGroups(GroupList list){
-  GroupList newGroupList = mkXA(GroupList)();
   for(int i = 0; i < list->size; ++i){
     Group newGroup = NULL;
+    clearScratchTable();
     while(list->data[i] != NULL){
       NodePos curPos = lpop(Group)(&(list->data[i]));
-      for(Group existingNode = newGroup; existingNode != NULL;
-          existingNode = existingNode->next){
-        if (existingNode->item == curPos){
-          goto is_duplicate;
-        }
+      if (scratchLookupOrAdd((UWord)(uintptr_t)curPos, 0) == -1){
+        lpush(Group)(&newGroup, curPos);
       }
-      lpush(Group)(&newGroup, curPos);
-    is_duplicate:;
     }
-    XApush(GroupList)(newGroupList, newGroup);
+    list->data[i] = newGroup;
   }
-  freeXA(GroupList)(list);
-  return newGroupList;
+  return list;
 }
 GroupList groupsWithoutNonVars(SymbExpr* structure, GroupList list,
                                int max_depth){
@@ -358,7 +631,6 @@ GroupList groupsWithoutNonVars(SymbExpr* structure, GroupList list,
   return newGroupList;
 }
 
-int numTrackedNodes(GroupList glist);
 int numTrackedNodes(GroupList glist){
   int count = 0;
   for(int i = 0; i < glist->size; ++i){
@@ -370,10 +642,9 @@ int numTrackedNodes(GroupList glist){
 int groupsGetTimes=0;
 GroupList getExprsEquivGroups(ConcExpr* concExpr, SymbExpr* symbExpr){
   GroupList groupList = mkXA(GroupList)();
-  VgHashTable* valMap = VG_(HT_construct)("val map");
-  getGrouped(groupList, valMap, concExpr, symbExpr,
+  clearScratchTable();
+  getGrouped(groupList, concExpr, symbExpr,
              null_pos, max_expr_block_depth);
-  VG_(HT_destruct)(valMap, VG_(free));
   GroupList prunedGroups = pruneSingletonGroups(groupList);
   return prunedGroups;
 }
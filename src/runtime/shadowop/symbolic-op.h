@@ -45,32 +45,17 @@ typedef struct _varMapEntry {
   UWord varIdx;
 } VarMapEntry;
 
-typedef struct _valMapEntry {
-  struct _valMapEntry* next;
-  UWord valHash;
-  double val;
-  UWord groupIdx;
-} ValMapEntry;
-
-typedef struct _rangeMapEntry {
-  struct _rangeMapEntry* next;
-  UWord positionHash;
-  NodePos position;
-  RangeRecord range_rec;
-} RangeMapEntry;
-typedef struct _exampleMapEntry {
-  struct _exampleMapEntry* next;
-  UWord positionHash;
-  NodePos position;
-  double value;
-} ExampleMapEntry;
 
 void execSymbolicOp(ShadowOpInfo* opinfo, ConcExpr** result,
                     double computedResult, ShadowValue** args,
                     Bool problematic);
-void generalizeSymbolicExpr(SymbExpr** symexpr, ConcExpr* cexpr);
+void execSymbolicOpLanes(ShadowOpInfo* opinfo, int numLanes,
+                         ShadowValue** results, double* computedResults,
+                         ShadowValue*** laneArgs, Bool* problematic);
+// Returns whether the symbolic expression changed.
+Bool generalizeSymbolicExpr(SymbExpr** symexpr, ConcExpr* cexpr);
 
-void generalizeStructure(SymbExpr* symbexpr, ConcExpr* concExpr,
+Bool generalizeStructure(SymbExpr* symbexpr, ConcExpr* concExpr,
                          int depth);
 void intersectEqualities(SymbExpr* symbexpr, ConcExpr* concExpr);
 GroupList getExprsEquivGroups(ConcExpr* concExpr, SymbExpr* symbExpr);
@@ -83,10 +68,7 @@ VarMap* mkVarMap(GroupList groups);
 int lookupVar(VarMap* map, NodePos pos);
 void freeVarMap(VarMap* map);
 
-void addValEntry(VgHashTable* valmap, double val, int groupIdx);
-int lookupVal(VgHashTable* valmap, double val);
 UWord hashValue(double val);
-Word cmp_value(const void* node1, const void* node2);
 
 ConcExpr* concExprPosGet(ConcExpr* expr, NodePos pos);
 SymbExpr* symbExprPosGet(SymbExpr* expr, NodePos pos);
@@ -60,6 +60,7 @@ List_Impl(NodePos, Group);
 Xarray_Impl(Group, GroupList);
 void initExprAllocator(void){
   leafCExprs = mkStack();
+  pendingCExprs = mkStack();
   for(int i = 0; i < MAX_BRANCH_ARGS; ++i){
     branchCExprs[i] = mkStack();
   }
@@ -69,8 +70,87 @@ void initExprAllocator(void){
 VG_REGPARM(1) void freeBranchConcExpr(ConcExpr* expr){
   stack_push(branchCExprs[expr->branch.nargs - 1], (void*)expr);
 }
-void recursivelyDisownConcExpr(ConcExpr* expr, int depth){
-  if (depth == 0) return;
+
+// Concrete expressions are reference counted structurally: each
+// branch holds one reference to each of its direct children, and
+// each shadow value holds one reference to its expression. So making
+// a node only touches its immediate arguments, no matter how deep the
+// tree under it is.
+//
+// Nodes whose count drops to zero aren't freed on the spot, since
+// that could cascade down an arbitrarily long chain. Instead they go
+// on a worklist, and every time we make a new node we do a bounded
+// amount of work reclaiming nodes from it.
+//
+// Structural counting alone would keep the entire history of a long
+// dependency chain alive, though, since every node points at the one
+// before it. Nobody looks more than CEXPR_KEEP_DEPTH levels down an
+// expression, so each node tracks its height, and when a node gets
+// more than twice that tall we cut it back down, replacing the
+// children at the cut with leaves carrying their values. Doing it
+// with that much slack means a long chain only gets cut once every
+// CEXPR_KEEP_DEPTH ops, so the cost of cutting stays constant per op
+// on average. Other roots can share nodes under the one being cut,
+// and those have to keep their structure, so cutting only changes
+// nodes in place when the root owns them outright, and copies any
+// shared node it has to cut below; see truncateConcExpr.
+#define CEXPR_KEEP_DEPTH (max_expr_block_depth * 2)
+#define CEXPR_RECLAIM_BATCH 8
+
+static Stack* pendingCExprs;
+
+// With --hashcons-exprs, branch nodes are interned by their op,
+// arguments, and value in a direct-mapped cache, so an op in a loop
+// that keeps computing the same thing from the same nodes reuses one
+// node instead of making a new one each time. The cache holds a
+// reference to each node in it, which it drops on eviction, so it
+// keeps at most CEXPR_CACHE_SIZE nodes alive on its own.
+#define CEXPR_CACHE_BITS 14
+#define CEXPR_CACHE_SIZE (1 << CEXPR_CACHE_BITS)
+static ConcExpr* cexprCache[CEXPR_CACHE_SIZE];
+
+static UWord hashConcExprKey(ShadowOpInfo* op, double value,
+                             int nargs, ConcExpr** args){
+  UWord hash = (UWord)op;
+  UWord valueBits;
+  VG_(memcpy)(&valueBits, &value, sizeof(UWord));
+  hash = hash * 31 + valueBits;
+  for(int i = 0; i < nargs; ++i){
+    hash = hash * 31 + (UWord)args[i];
+  }
+  return (hash ^ (hash >> 17) ^ (hash >> 33)) & (CEXPR_CACHE_SIZE - 1);
+}
+static Bool concExprMatches(ConcExpr* expr, ShadowOpInfo* op,
+                            double value, int nargs, ConcExpr** args){
+  if (expr->branch.op != op || expr->branch.nargs != nargs ||
+      VG_(memcmp)(&(expr->value), &value, sizeof(double)) != 0){
+    return False;
+  }
+  for(int i = 0; i < nargs; ++i){
+    if (expr->branch.args[i] != args[i]){
+      return False;
+    }
+  }
+  return True;
+}
+
+static void reclaimConcExprs(int budget){
+  for(int i = 0; i < budget && !stack_empty(pendingCExprs); ++i){
+    ConcExpr* expr = (void*)stack_pop(pendingCExprs);
+    if (print_expr_refs){
+      VG_(printf)("Reclaiming expr %p\n", expr);
+    }
+    if (expr->type == Node_Leaf){
+      stack_push(leafCExprs, (void*)expr);
+    } else {
+      for(int j = 0; j < expr->branch.nargs; ++j){
+        disownConcExpr(expr->branch.args[j]);
+      }
+      freeBranchConcExpr(expr);
+    }
+  }
+}
+void disownConcExpr(ConcExpr* expr){
   tl_assert2(expr->ref_count > 0,
              "The ref count of %p is already zero, and we're trying to decrease it!\n",
              expr);
@@ -81,24 +161,20 @@ void recursivelyDisownConcExpr(ConcExpr* expr, int depth){
   (expr->ref_count)--;
   if (expr->ref_count == 0){
     if (print_expr_refs){
-      VG_(printf)("No references left for expr %p! Freeing...\n", expr);
-    }
-    if (expr->type == Node_Leaf){
-      stack_push(leafCExprs, (void*)expr);
-    } else {
-      freeBranchConcExpr(expr);
-    }
-  }
-  if (expr->type == Node_Branch){
-    for(int i = 0; i < expr->branch.nargs; ++i){
-      recursivelyDisownConcExpr(expr->branch.args[i], depth - 1);
+      VG_(printf)("No references left for expr %p! Queueing it to be freed.\n",
+                  expr);
     }
+    stack_push(pendingCExprs, (void*)expr);
   }
 }
-void disownConcExpr(ConcExpr* expr){
-  recursivelyDisownConcExpr(expr, max_expr_block_depth * 2);
+void ownConcExpr(ConcExpr* expr){
+  if (print_expr_refs){
+    VG_(printf)("Increasing ref count of expr %p from %d to %d\n",
+                expr, expr->ref_count, expr->ref_count + 1);
+  }
+  (expr->ref_count)++;
 }
-ConcExpr* mkLeafConcExpr(double value){
+static ConcExpr* allocLeafConcExpr(double value){
   ConcExpr* result;
   if (stack_empty(leafCExprs)){
     result = VG_(malloc)("expr", sizeof(ConcExpr));
@@ -111,27 +187,16 @@ ConcExpr* mkLeafConcExpr(double value){
     VG_(printf)("Making new expression %p with 1 reference\n", result);
   }
   result->value = value;
+  result->height = 0;
+  result->merged_into = NULL;
 
   return result;
 }
-
-void recursivelyOwnConcExpr(ConcExpr* expr, int depth){
-  if (depth == 0) return;
-  if (print_expr_refs){
-    VG_(printf)("Increasing ref count of expr %p from %d to %d\n",
-                expr, expr->ref_count, expr->ref_count + 1);
-  }
-  (expr->ref_count)++;
-  if (expr->type == Node_Branch){
-    for(int i = 0; i < expr->branch.nargs; ++i){
-      tl_assert(expr->branch.args[i] != NULL);
-      recursivelyOwnConcExpr(expr->branch.args[i], depth - 1);
-    }
-  }
+ConcExpr* mkLeafConcExpr(double value){
+  reclaimConcExprs(CEXPR_RECLAIM_BATCH);
+  return allocLeafConcExpr(value);
 }
-
-ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op,
-                           int nargs, ConcExpr** args){
+static ConcExpr* allocBranchConcExpr(int nargs){
   ConcExpr* result;
   if (stack_empty(branchCExprs[nargs-1])){
     result = VG_(malloc)("expr", sizeof(ConcExpr));
@@ -142,21 +207,171 @@ ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op,
   } else {
     result = (void*)stack_pop(branchCExprs[nargs-1]);
   }
-  // We'll do ownership stuff at the end, leave it at 0 refs for now.
+  return result;
+}
+
+// The copies made of shared nodes during one truncation, by the
+// original node and the depth it was cut to, so that a node reached
+// by many paths through a DAG is only copied once per depth. Entries
+// from earlier truncations are told apart by their generation.
+typedef struct _truncCopy {
+  ConcExpr* original;
+  int depth;
+  UWord gen;
+  ConcExpr* copy;
+} TruncCopy;
+static TruncCopy* truncCopies = NULL;
+static SizeT truncCopiesCapacity = 0;
+static SizeT truncCopiesCount = 0;
+static UWord truncGen = 0;
+
+static TruncCopy* truncCopySlot(ConcExpr* original, int depth){
+  SizeT mask = truncCopiesCapacity - 1;
+  SizeT slot = (((UWord)original >> 4) * 31 + depth) & mask;
+  while(truncCopies[slot].gen == truncGen &&
+        (truncCopies[slot].original != original ||
+         truncCopies[slot].depth != depth)){
+    slot = (slot + 1) & mask;
+  }
+  return &(truncCopies[slot]);
+}
+static void growTruncCopies(void){
+  TruncCopy* oldCopies = truncCopies;
+  SizeT oldCapacity = truncCopiesCapacity;
+  truncCopiesCapacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+  truncCopies = VG_(malloc)("truncation copies",
+                            sizeof(TruncCopy) * truncCopiesCapacity);
+  VG_(memset)(truncCopies, 0, sizeof(TruncCopy) * truncCopiesCapacity);
+  for(SizeT i = 0; i < oldCapacity; ++i){
+    if (oldCopies[i].gen == truncGen){
+      *truncCopySlot(oldCopies[i].original, oldCopies[i].depth) =
+        oldCopies[i];
+    }
+  }
+  if (oldCopies != NULL){
+    VG_(free)(oldCopies);
+  }
+}
+
+static void truncateOwnedConcExpr(ConcExpr* expr, int depth);
+// Cut child, which its parent holds one reference to, back to depth,
+// and return the node the parent should point to instead. That's
+// child itself, unless child is shared, in which case the parent's
+// reference moves to a cut-down copy.
+static ConcExpr* truncateConcExprChild(ConcExpr* child, int depth){
+  if (child->height <= depth){
+    return child;
+  }
+  if (child->ref_count == 1){
+    truncateOwnedConcExpr(child, depth);
+    return child;
+  }
+  TruncCopy* existing = truncCopySlot(child, depth);
+  if (existing->gen == truncGen){
+    ownConcExpr(existing->copy);
+    disownConcExpr(child);
+    return existing->copy;
+  }
+  ConcExpr* copy = allocBranchConcExpr(child->branch.nargs);
+  copy->ref_count = 1;
+  copy->value = child->value;
+  copy->branch.op = child->branch.op;
+  copy->merged_into = NULL;
+  copy->height = child->height;
+  for(int i = 0; i < child->branch.nargs; ++i){
+    copy->branch.args[i] = child->branch.args[i];
+    ownConcExpr(copy->branch.args[i]);
+  }
+  truncateOwnedConcExpr(copy, depth);
+  if ((truncCopiesCount + 1) * 2 > truncCopiesCapacity){
+    growTruncCopies();
+  }
+  TruncCopy* entry = truncCopySlot(child, depth);
+  entry->original = child;
+  entry->depth = depth;
+  entry->gen = truncGen;
+  entry->copy = copy;
+  truncCopiesCount++;
+  disownConcExpr(child);
+  return copy;
+}
+// Cut off everything more than depth levels below expr, which nobody
+// else can see, and set its new height. Nothing gets reclaimed until
+// we're done, so the nodes we've remembered stay put.
+static void truncateOwnedConcExpr(ConcExpr* expr, int depth){
+  int height = 0;
+  for(int i = 0; i < expr->branch.nargs; ++i){
+    ConcExpr* child = expr->branch.args[i];
+    if (depth == 1){
+      if (child->type == Node_Branch){
+        expr->branch.args[i] = allocLeafConcExpr(child->value);
+        disownConcExpr(child);
+      }
+      height = 1;
+    } else {
+      child = truncateConcExprChild(child, depth - 1);
+      expr->branch.args[i] = child;
+      if (child->height + 1 > height){
+        height = child->height + 1;
+      }
+    }
+  }
+  expr->height = height;
+}
+static void truncateConcExpr(ConcExpr* expr, int depth){
+  tl_assert(expr->ref_count == 1);
+  truncGen++;
+  truncCopiesCount = 0;
+  if (truncCopies == NULL){
+    growTruncCopies();
+  }
+  truncateOwnedConcExpr(expr, depth);
+}
+
+ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op,
+                           int nargs, ConcExpr** args){
+  ConcExpr* result;
+  reclaimConcExprs(CEXPR_RECLAIM_BATCH);
+  UWord cacheIdx = 0;
+  if (hashcons_exprs){
+    cacheIdx = hashConcExprKey(op, value, nargs, args);
+    ConcExpr* cached = cexprCache[cacheIdx];
+    if (cached != NULL &&
+        concExprMatches(cached, op, value, nargs, args)){
+      ownConcExpr(cached);
+      return cached;
+    }
+  }
+  result = allocBranchConcExpr(nargs);
   if (print_expr_refs){
-    VG_(printf)("Making new expression %p with 0 references\n", result);
+    VG_(printf)("Making new expression %p with 1 reference\n", result);
   }
-  result->ref_count = 0;
+  result->ref_count = 1;
   result->value = value;
   result->branch.op = op;
+  result->merged_into = NULL;
 
+  int height = 0;
   for(int i = 0; i < nargs; ++i){
     tl_assert(i < result->branch.nargs);
-    tl_assert(result->branch.nargs > i);
+    tl_assert(args[i] != NULL);
     result->branch.args[i] = args[i];
+    ownConcExpr(args[i]);
+    if (args[i]->height + 1 > height){
+      height = args[i]->height + 1;
+    }
+  }
+  result->height = height;
+  if (height > 2 * CEXPR_KEEP_DEPTH){
+    truncateConcExpr(result, CEXPR_KEEP_DEPTH);
+  }
+  if (hashcons_exprs){
+    if (cexprCache[cacheIdx] != NULL){
+      disownConcExpr(cexprCache[cacheIdx]);
+    }
+    ownConcExpr(result);
+    cexprCache[cacheIdx] = result;
   }
-
-  recursivelyOwnConcExpr(result, max_expr_block_depth * 2);
   return result;
 }
 
@@ -359,10 +574,144 @@ SymbExpr* varSwallow(SymbExpr* expr){
   return expr;
 }
 
+static int countPosIndexNodes(SymbExpr* curExpr, int depth){
+  int count = 1;
+  if (depth < MAX_FOLD_DEPTH && curExpr->type == Node_Branch){
+    for(int i = 0; i < curExpr->branch.nargs; ++i){
+      count += countPosIndexNodes(curExpr->branch.args[i], depth + 1);
+    }
+  }
+  return count;
+}
+static int fillPosIndex(PosIndex* index, SymbExpr* curExpr,
+                        NodePos curPos, int* nextIdx){
+  int idx = (*nextIdx)++;
+  index->positions[idx] = curPos;
+  for(int i = 0; i < MAX_BRANCH_ARGS; ++i){
+    index->children[idx * MAX_BRANCH_ARGS + i] = -1;
+  }
+  if (curPos->len < MAX_FOLD_DEPTH && curExpr->type == Node_Branch){
+    for(int i = 0; i < curExpr->branch.nargs; ++i){
+      index->children[idx * MAX_BRANCH_ARGS + i] =
+        fillPosIndex(index, curExpr->branch.args[i],
+                     rconsPos(curPos, i), nextIdx);
+    }
+  }
+  return idx;
+}
+// Give every node along pos an index, if it doesn't have one
+// already. New nodes go on the end, which keeps every node after its
+// parent.
+static void addPosToIndex(PosIndex* index, NodePos pos, int* nextIdx){
+  int idx = 0;
+  NodePos curPos = null_pos;
+  for(int i = 0; i < pos->len; ++i){
+    tl_assert(pos->data[i] < MAX_BRANCH_ARGS);
+    curPos = rconsPos(curPos, pos->data[i]);
+    int* childIdx = &(index->children[idx * MAX_BRANCH_ARGS + pos->data[i]]);
+    if (*childIdx == -1){
+      int newIdx = (*nextIdx)++;
+      index->positions[newIdx] = curPos;
+      for(int j = 0; j < MAX_BRANCH_ARGS; ++j){
+        index->children[newIdx * MAX_BRANCH_ARGS + j] = -1;
+      }
+      *childIdx = newIdx;
+    }
+    idx = *childIdx;
+  }
+}
+void buildPosIndex(SymbExpr* symbExpr){
+  tl_assert(symbExpr->type == Node_Branch);
+  tl_assert(symbExpr->branch.nargs <= MAX_BRANCH_ARGS);
+  PosIndex* index = &(symbExpr->branch.posIndex);
+  GroupList groups = symbExpr->branch.groups;
+  int numStructureNodes = countPosIndexNodes(symbExpr, 0);
+  // Leave room for the paths to any group members that are too deep
+  // to be in the structure part of the index.
+  int maxNodes = numStructureNodes;
+  for(int i = 0; i < groups->size; ++i){
+    for(Group curNode = groups->data[i];
+        curNode != NULL; curNode = curNode->next){
+      if (curNode->item->len > MAX_FOLD_DEPTH){
+        maxNodes += curNode->item->len;
+      }
+    }
+  }
+  index->positions =
+    VG_(perm_malloc)(sizeof(NodePos) * maxNodes,
+                     vg_alignof(NodePos));
+  index->children =
+    VG_(perm_malloc)(sizeof(int) * maxNodes * MAX_BRANCH_ARGS,
+                     vg_alignof(int));
+  int nextIdx = 0;
+  fillPosIndex(index, symbExpr, null_pos, &nextIdx);
+  tl_assert(nextIdx == numStructureNodes);
+  for(int i = 0; i < groups->size; ++i){
+    for(Group curNode = groups->data[i];
+        curNode != NULL; curNode = curNode->next){
+      if (curNode->item->len > MAX_FOLD_DEPTH){
+        addPosToIndex(index, curNode->item, &nextIdx);
+      }
+    }
+  }
+  tl_assert(nextIdx <= maxNodes);
+  index->numNodes = nextIdx;
+}
+int posIndexOf(SymbExpr* symbExpr, NodePos pos){
+  PosIndex* index = &(symbExpr->branch.posIndex);
+  int idx = 0;
+  for(int i = 0; i < pos->len && idx != -1; ++i){
+    if (pos->data[i] >= MAX_BRANCH_ARGS){
+      return -1;
+    }
+    idx = index->children[idx * MAX_BRANCH_ARGS + pos->data[i]];
+  }
+  return idx;
+}
+// Since the index is in preorder, every node comes after its parent,
+// so one pass forwards over it is enough to fill in the whole tree.
+void flattenConcExpr(SymbExpr* symbExpr, ConcExpr* cexpr, ConcExpr** out){
+  PosIndex* index = &(symbExpr->branch.posIndex);
+  out[0] = cexpr;
+  for(int idx = 0; idx < index->numNodes; ++idx){
+    ConcExpr* node = out[idx];
+    for(int i = 0; i < MAX_BRANCH_ARGS; ++i){
+      int childIdx = index->children[idx * MAX_BRANCH_ARGS + i];
+      if (childIdx == -1){
+        continue;
+      }
+      if (node == NULL || node->type == Node_Leaf ||
+          node->branch.nargs <= i){
+        out[childIdx] = NULL;
+      } else {
+        out[childIdx] = node->branch.args[i];
+      }
+    }
+  }
+}
+void flattenSymbExpr(SymbExpr* symbExpr, SymbExpr** out){
+  PosIndex* index = &(symbExpr->branch.posIndex);
+  out[0] = symbExpr;
+  for(int idx = 0; idx < index->numNodes; ++idx){
+    SymbExpr* node = out[idx];
+    for(int i = 0; i < MAX_BRANCH_ARGS; ++i){
+      int childIdx = index->children[idx * MAX_BRANCH_ARGS + i];
+      if (childIdx == -1){
+        continue;
+      }
+      if (node == NULL || node->type == Node_Leaf ||
+          node->branch.nargs <= i){
+        out[childIdx] = NULL;
+      } else {
+        out[childIdx] = node->branch.args[i];
+      }
+    }
+  }
+}
+
 void recursivelyInitializeRangesAndExample(SymbExpr* curExpr, NodePos curPos,
                                            OSet* seenNodes,
-                                           VgHashTable* rangeTable,
-                                           VgHashTable* exampleTable,
+                                           SymbExpr* tableExpr,
                                            int max_depth);
 // This function initializes a range table for the given symbolic
 // expression. Range tables are maps from node positions to
@@ -384,7 +733,7 @@ void initializeProblematicRangesAndExample(SymbExpr* symbExpr){
   // don't have range maps or equivalence groups, since they would be
   // trivial.
   tl_assert(symbExpr->type == Node_Branch);
-
+  buildPosIndex(symbExpr);
 
   // To make sure we properly adhere to the invariant mentioned above,
   // we'll keep track of which nodes have been seen in equivalence
@@ -392,10 +741,26 @@ void initializeProblematicRangesAndExample(SymbExpr* symbExpr){
   // seperately, to the range table.
   OSet* nodesInGroups = VG_(OSetWord_Create)(VG_(malloc), "varset", VG_(free));
   // Initialize the range table.
-  symbExpr->branch.varProblematicRanges =
-    VG_(HT_construct)("Variable problematic ranges table");
-  symbExpr->branch.exampleProblematicArgs =
-    VG_(HT_construct)("example problematic inputs array");
+  int numNodes = symbExpr->branch.posIndex.numNodes;
+  RangeTable* table = &(symbExpr->branch.ranges);
+  table->numEntries = 0;
+  table->entryNode =
+    VG_(perm_malloc)(sizeof(int) * numNodes, vg_alignof(int));
+  table->entryOf =
+    VG_(perm_malloc)(sizeof(int) * numNodes, vg_alignof(int));
+  for(int i = 0; i < numNodes; ++i){
+    table->entryOf[i] = -1;
+  }
+  table->negMin =
+    VG_(perm_malloc)(sizeof(double) * numNodes, vg_alignof(double));
+  table->negMax =
+    VG_(perm_malloc)(sizeof(double) * numNodes, vg_alignof(double));
+  table->posMin =
+    VG_(perm_malloc)(sizeof(double) * numNodes, vg_alignof(double));
+  table->posMax =
+    VG_(perm_malloc)(sizeof(double) * numNodes, vg_alignof(double));
+  table->example =
+    VG_(perm_malloc)(sizeof(double) * numNodes, vg_alignof(double));
 
   // Part (a)
 
@@ -408,8 +773,8 @@ void initializeProblematicRangesAndExample(SymbExpr* symbExpr){
     // and if they are we'll update the ranges later in the symbolic
     // op with that info.
     NodePos curPos = symbExpr->branch.groups->data[i]->item;
-    addInitialRangeEntry(symbExpr->branch.varProblematicRanges, curPos);
-    addInitialExampleEntry(symbExpr->branch.exampleProblematicArgs, curPos);
+    addInitialRangeEntry(symbExpr, curPos);
+    addInitialExampleEntry(symbExpr, curPos);
 
     // Add every node in this group to the set of nodes in groups, so
     // that we don't add them again.
@@ -441,153 +806,190 @@ void initializeProblematicRangesAndExample(SymbExpr* symbExpr){
   for (int i = 0; i < symbExpr->branch.nargs; ++i){
     recursivelyInitializeRangesAndExample(symbExpr->branch.args[i],
                                           rconsPos(null_pos, i),
-                                          nodesInGroups,
-                                          symbExpr->branch.varProblematicRanges,
-                                          symbExpr->branch.exampleProblematicArgs,
+                                          nodesInGroups, symbExpr,
                                           MAX_FOLD_DEPTH);
   }
   VG_(OSetWord_Destroy)(nodesInGroups);
 }
 void recursivelyInitializeRangesAndExample(SymbExpr* curExpr, NodePos curPos,
                                            OSet* nodesInGroups,
-                                           VgHashTable* rangeTable,
-                                           VgHashTable* exampleTable,
+                                           SymbExpr* tableExpr,
                                            int max_depth){
   if (!(VG_(OSetWord_Contains)(nodesInGroups, (UWord)(uintptr_t)curPos))){
-    addInitialRangeEntry(rangeTable, curPos);
-    addInitialExampleEntry(exampleTable, curPos);
+    addInitialRangeEntry(tableExpr, curPos);
+    addInitialExampleEntry(tableExpr, curPos);
   }
   if (max_depth > 1 && curExpr->type == Node_Branch){
     for(int i = 0; i < curExpr->branch.nargs; ++i){
       recursivelyInitializeRangesAndExample(curExpr->branch.args[i], rconsPos(curPos, i),
-                                            nodesInGroups, rangeTable, exampleTable,
+                                            nodesInGroups, tableExpr,
                                             max_depth - 1);
     }
   }
 }
 
-void addRangeEntryCopy(VgHashTable* rangeMap, NodePos position, RangeRecord* original){
-  RangeMapEntry* newEntry =
-    VG_(malloc)("variable range map entry", sizeof(RangeMapEntry));
-  copyRangeRecordInPlace(&(newEntry->range_rec), original);
-
-  newEntry->positionHash = hashPosition(position);
-  newEntry->position = position;
-  VG_(HT_add_node)(rangeMap, newEntry);
+static int rangeEntryIdx(SymbExpr* symbExpr, NodePos position){
+  int idx = posIndexOf(symbExpr, position);
+  tl_assert2(idx != -1, "Position isn't in the expression's index!");
+  return idx;
 }
-void addInitialRangeEntry(VgHashTable* rangeMap, NodePos position){
-  RangeMapEntry* newEntry =
-    VG_(malloc)("variable range map entry", sizeof(RangeMapEntry));
-  initRangeRecord(&(newEntry->range_rec));
-
-  newEntry->positionHash = hashPosition(position);
-  newEntry->position = position;
-  VG_(HT_add_node)(rangeMap, newEntry);
+// The entry for position in symbExpr's range table, making a fresh
+// one if it doesn't have one yet.
+static int rangeEntryFor(SymbExpr* symbExpr, NodePos position){
+  RangeTable* table = &(symbExpr->branch.ranges);
+  int idx = rangeEntryIdx(symbExpr, position);
+  int entry = table->entryOf[idx];
+  if (entry == -1){
+    entry = table->numEntries++;
+    table->entryOf[idx] = entry;
+    table->entryNode[entry] = idx;
+    table->negMin[entry] = INFINITY;
+    table->negMax[entry] = -INFINITY;
+    table->posMin[entry] = INFINITY;
+    table->posMax[entry] = -INFINITY;
+    table->example[entry] = NAN;
+  }
+  return entry;
+}
+void addRangeEntryCopy(SymbExpr* symbExpr, NodePos position, RangeRecord* original){
+  RangeTable* table = &(symbExpr->branch.ranges);
+  int entry = rangeEntryFor(symbExpr, position);
+  table->negMin[entry] = original->neg_range.min;
+  table->negMax[entry] = original->neg_range.max;
+  table->posMin[entry] = original->pos_range.min;
+  table->posMax[entry] = original->pos_range.max;
 }
-void addExampleEntryCopy(VgHashTable* exampleTable,
+void addInitialRangeEntry(SymbExpr* symbExpr, NodePos position){
+  RangeTable* table = &(symbExpr->branch.ranges);
+  int entry = rangeEntryFor(symbExpr, position);
+  table->negMin[entry] = INFINITY;
+  table->negMax[entry] = -INFINITY;
+  table->posMin[entry] = INFINITY;
+  table->posMax[entry] = -INFINITY;
+}
+void addExampleEntryCopy(SymbExpr* symbExpr,
                          NodePos position, double original){
-  ExampleMapEntry* newEntry =
-    VG_(malloc)("variable range map entry", sizeof(RangeMapEntry));
-  newEntry->value = original;
-
-  newEntry->positionHash = hashPosition(position);
-  newEntry->position = position;
-  VG_(HT_add_node)(exampleTable, newEntry);
+  int entry = rangeEntryFor(symbExpr, position);
+  symbExpr->branch.ranges.example[entry] = original;
 }
-void addInitialExampleEntry(VgHashTable* exampleTable, NodePos position){
-  ExampleMapEntry* newEntry =
-    VG_(malloc)("variable range map entry", sizeof(ExampleMapEntry));
-  newEntry->value = NAN;
-
-  newEntry->positionHash = hashPosition(position);
-  newEntry->position = position;
-  VG_(HT_add_node)(exampleTable, newEntry);
+void addInitialExampleEntry(SymbExpr* symbExpr, NodePos position){
+  int entry = rangeEntryFor(symbExpr, position);
+  symbExpr->branch.ranges.example[entry] = NAN;
 }
 
-List_H(RangeMapEntry*, RangeEntryList);
-List_Impl(RangeMapEntry*, RangeEntryList);
-
 void updateProblematicRanges(SymbExpr* symbExpr, ConcExpr* cexpr){
-  VgHashTable* rangeTable = symbExpr->branch.varProblematicRanges;
-  VgHashTable* exampleTable = symbExpr->branch.exampleProblematicArgs;
-  RangeEntryList expiredEntries = NULL;
-
-  {
-    VG_(HT_ResetIter)(rangeTable);
-    RangeMapEntry* entry;
-    while((entry = VG_(HT_Next)(rangeTable)) != NULL){
-      ConcExpr* sampleConcNode = concExprPosGet(cexpr, entry->position);
-      // The node mentioned by this table entry might not exist in the
-      // concrete expression we're generalizing with, in which case it
-      // won't exist anymore in the symbolic expression either. If
-      // that's the case, we'll remove it from the range table so that
-      // we don't bother trying to maintain it later.
-      if (sampleConcNode == NULL){
-        // Unfortunately, we can't remove the node directly from the
-        // table since that would violate the iterator invariants, so
-        // we'll just add it to a stack to be removed at the end of the
-        // update.
-        lpush(RangeEntryList)(&expiredEntries, entry);
-      } else {
-        // If the node DOES exist, we should update the range table entry.
-        updateRangeRecord(&(entry->range_rec), sampleConcNode->value);
-      }
+  static ConcExpr** flatConc = NULL;
+  static SymbExpr** flatSymb = NULL;
+  static double* values = NULL;
+  static int flatConcSize = 0;
+  int numNodes = symbExpr->branch.posIndex.numNodes;
+  if (flatConcSize < numNodes){
+    if (flatConc != NULL){
+      VG_(free)(flatConc);
+      VG_(free)(flatSymb);
+      VG_(free)(values);
     }
+    flatConc = VG_(malloc)("flattened concrete expr",
+                           sizeof(ConcExpr*) * numNodes);
+    flatSymb = VG_(malloc)("flattened symbolic expr",
+                           sizeof(SymbExpr*) * numNodes);
+    values = VG_(malloc)("range table values",
+                         sizeof(double) * numNodes);
+    flatConcSize = numNodes;
   }
-  // Remove all the expired entries.
-  while(length(RangeEntryList)(&expiredEntries) > 0){
-    RangeMapEntry* expiredEntry = lpop(RangeEntryList)(&expiredEntries);
-    VG_(HT_gen_remove)(rangeTable, expiredEntry, cmp_position);
-    // This should work? Since gen_remove should only need to look at
-    // the position and positionHash of the entry, and those two
-    // things are the same across both RangeMapEntry and
-    // ExampleMapEntry.
-    VG_(HT_gen_remove)(exampleTable, expiredEntry, cmp_position);
-  }
-  // Now let's do the example problematic inputs
+  flattenConcExpr(symbExpr, cexpr, flatConc);
+  flattenSymbExpr(symbExpr, flatSymb);
+
+  RangeTable* table = &(symbExpr->branch.ranges);
+  // First, gather the value for each entry. The node mentioned by an
+  // entry might have been generalized away from the symbolic
+  // expression, in which case we'll drop the entry, sliding the live
+  // ones down over it, so that we don't bother trying to maintain it
+  // later. If the node is still there but the concrete expression
+  // doesn't have it, the entry stays as it is: a NaN value can't
+  // move a range, and this execution doesn't get to be the example.
+  int numLive = 0;
   int exampleFullyInitialized = 1;
-  {
-    VG_(HT_ResetIter)(exampleTable);
-    ExampleMapEntry* entry;
-    while((entry = VG_(HT_Next)(exampleTable)) != NULL){
-      if (entry->value != entry->value){
-        exampleFullyInitialized = 0;
-        break;
-      }
+  int concreteCoversEntries = 1;
+  for(int i = 0; i < table->numEntries; ++i){
+    int idx = table->entryNode[i];
+    if (flatSymb[idx] == NULL){
+      table->entryOf[idx] = -1;
+      continue;
     }
-    if (!exampleFullyInitialized){
-      VG_(HT_ResetIter)(exampleTable);
-      while((entry = VG_(HT_Next)(exampleTable)) != NULL){
-        ConcExpr* sampleConcNode = concExprPosGet(cexpr, entry->position);
-        tl_assert(sampleConcNode != NULL);
-        entry->value = sampleConcNode->value;
-      }
+    if (numLive != i){
+      table->entryNode[numLive] = idx;
+      table->entryOf[idx] = numLive;
+      table->negMin[numLive] = table->negMin[i];
+      table->negMax[numLive] = table->negMax[i];
+      table->posMin[numLive] = table->posMin[i];
+      table->posMax[numLive] = table->posMax[i];
+      table->example[numLive] = table->example[i];
+    }
+    if (flatConc[idx] == NULL){
+      values[numLive] = NAN;
+      concreteCoversEntries = 0;
+    } else {
+      values[numLive] = flatConc[idx]->value;
+    }
+    if (table->example[numLive] != table->example[numLive]){
+      exampleFullyInitialized = 0;
     }
+    numLive++;
+  }
+  table->numEntries = numLive;
+
+  // Now fold the values into the ranges. This does the same thing as
+  // updateRangeRecord, but with selects instead of branches so that
+  // it can be vectorized; values that don't belong in a range are
+  // replaced by infinities that can't move it, and NaNs fail every
+  // comparison so they never get stored.
+  double* negMin = table->negMin;
+  double* negMax = table->negMax;
+  double* posMin = table->posMin;
+  double* posMax = table->posMax;
+  for(int i = 0; i < numLive; ++i){
+    double value = values[i];
+    int isPos = value > 0 || !detailed_ranges;
+    double posLow = isPos ? value : INFINITY;
+    double posHigh = isPos ? value : -INFINITY;
+    double negLow = isPos ? INFINITY : value;
+    double negHigh = isPos ? -INFINITY : value;
+    posMin[i] = posLow < posMin[i] ? posLow : posMin[i];
+    posMax[i] = posHigh > posMax[i] ? posHigh : posMax[i];
+    negMin[i] = negLow < negMin[i] ? negLow : negMin[i];
+    negMax[i] = negHigh > negMax[i] ? negHigh : negMax[i];
+  }
+  // Now let's do the example problematic inputs
+  if (!exampleFullyInitialized && concreteCoversEntries){
+    VG_(memcpy)(table->example, values, sizeof(double) * numLive);
   }
 }
 
-RangeRecord* lookupRangeRecord(VgHashTable* rangeMap, NodePos position){
-  RangeMapEntry key = {.position = position,
-                       .positionHash = hashPosition(position)};
-  RangeMapEntry* entry =
-    VG_(HT_gen_lookup)(rangeMap, &key, cmp_position);
-  if (entry == NULL) return NULL;
-  return &(entry->range_rec);
+Bool lookupRangeRecord(SymbExpr* symbExpr, NodePos position,
+                       RangeRecord* out){
+  RangeTable* table = &(symbExpr->branch.ranges);
+  int idx = posIndexOf(symbExpr, position);
+  if (idx == -1 || table->entryOf[idx] == -1) return False;
+  int entry = table->entryOf[idx];
+  out->neg_range.min = table->negMin[entry];
+  out->neg_range.max = table->negMax[entry];
+  out->pos_range.min = table->posMin[entry];
+  out->pos_range.max = table->posMax[entry];
+  return True;
 }
-double lookupExampleInput(VgHashTable* exampleMap, NodePos position){
-  ExampleMapEntry key = {.position = position,
-                         .positionHash = hashPosition(position)};
-  ExampleMapEntry* entry =
-    VG_(HT_gen_lookup)(exampleMap, &key, cmp_position);
-  tl_assert(entry != NULL);
-  return entry->value;
+double lookupExampleInput(SymbExpr* symbExpr, NodePos position){
+  RangeTable* table = &(symbExpr->branch.ranges);
+  int idx = posIndexOf(symbExpr, position);
+  tl_assert(idx != -1 && table->entryOf[idx] != -1);
+  return table->example[table->entryOf[idx]];
 }
 
 void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problematicRanges,
                                double* exampleInput,
                                SymbExpr* curExpr, int* nextVarIdx, NodePos curPos,
-                               OSet* seenNodes, VgHashTable* rangeTable,
-                               VgHashTable* exampleTable, int max_depth, int num_vars);
+                               OSet* seenNodes, SymbExpr* tableExpr,
+                               int max_depth, int num_vars);
 void getRangesAndExample(RangeRecord** totalRangesOut,
                          RangeRecord** problematicRangesOut,
                          double** exampleInputOut,
@@ -643,23 +1045,20 @@ void getRangesAndExample(RangeRecord** totalRangesOut,
     tl_assert(nextVarIdx < num_vars);
     (*totalRangesOut)[nextVarIdx] =
       sampleParent->branch.op->agg.inputs.range_records[childIndex];
-    VgHashTable* rangeTable = expr->branch.varProblematicRanges;
-    RangeRecord* entry = lookupRangeRecord(rangeTable, canonicalPos);
-    if (entry == NULL){
+    if (!lookupRangeRecord(expr, canonicalPos,
+                           &((*problematicRangesOut)[nextVarIdx]))){
       VG_(printf)("Expr: ");
       ppSymbExpr(expr);
       VG_(printf)(" (%p)\n", expr);
       VG_(printf)("Couldn't find range table entry for ");
       ppNodePos(samplePos);
       VG_(printf)("\nTable is:\n");
-      ppRangeTable(rangeTable);
+      ppRangeTable(expr);
       VG_(printf)("Groups are:\n");
       ppEquivGroups(groups);
-      tl_assert(entry != NULL);
+      tl_assert(0);
     }
-    (*problematicRangesOut)[nextVarIdx] = *entry;
-    VgHashTable* exampleTable = expr->branch.exampleProblematicArgs;
-    (*exampleInputOut)[nextVarIdx] = lookupExampleInput(exampleTable, canonicalPos);
+    (*exampleInputOut)[nextVarIdx] = lookupExampleInput(expr, canonicalPos);
     nextVarIdx++;
 
     for(Group curNode = curGroup; curNode != NULL; curNode = curNode->next){
@@ -669,8 +1068,7 @@ void getRangesAndExample(RangeRecord** totalRangesOut,
 
   recursivelyPopulateRanges(*totalRangesOut, *problematicRangesOut,
                             *exampleInputOut, expr, &nextVarIdx, null_pos,
-                            seenNodes, expr->branch.varProblematicRanges,
-                            expr->branch.exampleProblematicArgs,
+                            seenNodes, expr,
                             MAX_FOLD_DEPTH, num_vars);
   VG_(OSetWord_Destroy)(seenNodes);
 }
@@ -678,13 +1076,13 @@ void getRangesAndExample(RangeRecord** totalRangesOut,
 void registerPotentialVar(SymbExpr* node, SymbExpr* parent, int childIndex,
                           RangeRecord* totalRanges, RangeRecord* problematicRanges,
                           double* exampleInput, int* nextVarIdx, OSet* seenNodes,
-                          VgHashTable* rangeTable, VgHashTable* exampleTable,
+                          SymbExpr* tableExpr,
                           NodePos childPos, int num_vars);
 void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problematicRanges,
                                double* exampleInput,
                                SymbExpr* curExpr, int* nextVarIdx, NodePos curPos,
-                               OSet* seenNodes, VgHashTable* rangeTable,
-                               VgHashTable* exampleTable, int max_depth,
+                               OSet* seenNodes, SymbExpr* tableExpr,
+                               int max_depth,
                                int num_vars){
   tl_assert(curExpr->type == Node_Branch);
   if (sound_simplify){
@@ -707,12 +1105,12 @@ void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problemati
             if (arg1->type == Node_Branch && max_depth > 1){
               recursivelyPopulateRanges(totalRanges, problematicRanges, exampleInput,
                                         arg1, nextVarIdx, rconsPos(curPos, 1),
-                                        seenNodes, rangeTable, exampleTable,
+                                        seenNodes, tableExpr,
                                         max_depth - 1, num_vars);
             } else {
               registerPotentialVar(arg1, curExpr, 1,
                                    totalRanges, problematicRanges, exampleInput,
-                                   nextVarIdx, seenNodes, rangeTable, exampleTable,
+                                   nextVarIdx, seenNodes, tableExpr,
                                    rconsPos(curPos, 1), num_vars);
             }
             return;
@@ -721,12 +1119,12 @@ void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problemati
             if (arg0->type == Node_Branch && max_depth > 1){
               recursivelyPopulateRanges(totalRanges, problematicRanges, exampleInput,
                                         arg0, nextVarIdx, rconsPos(curPos, 0),
-                                        seenNodes, rangeTable, exampleTable,
+                                        seenNodes, tableExpr,
                                         max_depth - 1, num_vars);
             } else {
               registerPotentialVar(arg0, curExpr, 0,
                                    totalRanges, problematicRanges, exampleInput,
-                                   nextVarIdx, seenNodes, rangeTable, exampleTable,
+                                   nextVarIdx, seenNodes, tableExpr,
                                    rconsPos(curPos, 0), num_vars);
             }
             return;
@@ -756,12 +1154,12 @@ void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problemati
             if (arg1->type == Node_Branch && max_depth > 1){
               recursivelyPopulateRanges(totalRanges, problematicRanges, exampleInput,
                                         arg1, nextVarIdx, rconsPos(curPos, 1),
-                                        seenNodes, rangeTable, exampleTable,
+                                        seenNodes, tableExpr,
                                         max_depth - 1, num_vars);
             } else {
               registerPotentialVar(arg1, curExpr, 1,
                                    totalRanges, problematicRanges, exampleInput,
-                                   nextVarIdx, seenNodes, rangeTable, exampleTable,
+                                   nextVarIdx, seenNodes, tableExpr,
                                    rconsPos(curPos, 1), num_vars);
             }
             return;
@@ -770,12 +1168,12 @@ void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problemati
             if (arg0->type == Node_Branch && max_depth > 1){
               recursivelyPopulateRanges(totalRanges, problematicRanges, exampleInput,
                                         arg0, nextVarIdx, rconsPos(curPos, 0),
-                                        seenNodes, rangeTable, exampleTable,
+                                        seenNodes, tableExpr,
                                         max_depth - 1, num_vars);
             } else {
               registerPotentialVar(arg0, curExpr, 0,
                                    totalRanges, problematicRanges, exampleInput,
-                                   nextVarIdx, seenNodes, rangeTable, exampleTable,
+                                   nextVarIdx, seenNodes, tableExpr,
                                    rconsPos(curPos, 0), num_vars);
             }
             return;
@@ -801,12 +1199,12 @@ void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problemati
             if (arg0->type == Node_Branch && max_depth > 1){
               recursivelyPopulateRanges(totalRanges, problematicRanges, exampleInput,
                                         arg0, nextVarIdx, rconsPos(curPos, 0),
-                                        seenNodes, rangeTable, exampleTable,
+                                        seenNodes, tableExpr,
                                         max_depth - 1, num_vars);
             } else {
               registerPotentialVar(arg0, curExpr, 0,
                                    totalRanges, problematicRanges, exampleInput,
-                                   nextVarIdx, seenNodes, rangeTable, exampleTable,
+                                   nextVarIdx, seenNodes, tableExpr,
                                    rconsPos(curPos, 0), num_vars);
             }
             return;
@@ -824,13 +1222,13 @@ void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problemati
     if (childExpr->type == Node_Leaf || max_depth == 1){
       registerPotentialVar(childExpr, curExpr, i,
                            totalRanges, problematicRanges, exampleInput,
-                           nextVarIdx, seenNodes, rangeTable, exampleTable,
+                           nextVarIdx, seenNodes, tableExpr,
                            childPos, num_vars);
     } else {
       recursivelyPopulateRanges(totalRanges, problematicRanges,
                                 exampleInput,
                                 childExpr, nextVarIdx, childPos,
-                                seenNodes, rangeTable, exampleTable,
+                                seenNodes, tableExpr,
                                 max_depth - 1, num_vars);
     }
   }
@@ -839,7 +1237,7 @@ void recursivelyPopulateRanges(RangeRecord* totalRanges, RangeRecord* problemati
 void registerPotentialVar(SymbExpr* node, SymbExpr* parent, int childIndex,
                           RangeRecord* totalRanges, RangeRecord* problematicRanges,
                           double* exampleInput, int* nextVarIdx, OSet* seenNodes,
-                          VgHashTable* rangeTable, VgHashTable* exampleTable,
+                          SymbExpr* tableExpr,
                           NodePos childPos, int num_vars){
   if (!node->isConst &&
       !(VG_(OSetWord_Contains)(seenNodes, (UWord)(uintptr_t)childPos))){
@@ -850,28 +1248,26 @@ void registerPotentialVar(SymbExpr* node, SymbExpr* parent, int childIndex,
     /*            "Expr %p (child %d of %p, opinfo %p), " */
     /*            "is non-const, but has a range with only one value!\n", */
     /*            node, childIndex, parent, parent->branch.op); */
-    RangeRecord* result = lookupRangeRecord(rangeTable, childPos);
-    if (result == NULL){
+    if (!lookupRangeRecord(tableExpr, childPos,
+                           &(problematicRanges[*nextVarIdx]))){
       VG_(printf)("Couldn't find range table entry for ");
       ppNodePos(childPos);
       VG_(printf)("\nTable is:\n");
-      ppRangeTable(rangeTable);
-      tl_assert(result != NULL);
+      ppRangeTable(tableExpr);
+      tl_assert(0);
     }
-    problematicRanges[*nextVarIdx] = *result;
-    exampleInput[*nextVarIdx] = lookupExampleInput(exampleTable, childPos);
+    exampleInput[*nextVarIdx] = lookupExampleInput(tableExpr, childPos);
     (*nextVarIdx)++;
   }
 }
 
-void ppRangeTable(VgHashTable* rangeTable){
-  VG_(HT_ResetIter)(rangeTable);
-  RangeMapEntry* entry;
-  while((entry = VG_(HT_Next)(rangeTable)) != NULL){
-    ppNodePos(entry->position);
+void ppRangeTable(SymbExpr* symbExpr){
+  RangeTable* table = &(symbExpr->branch.ranges);
+  for(int i = 0; i < table->numEntries; ++i){
+    ppNodePos(symbExpr->branch.posIndex.positions[table->entryNode[i]]);
     VG_(printf)(" -> [%f, %f]\n",
-                entry->range_rec.neg_range.min,
-                entry->range_rec.pos_range.max);
+                table->negMin[i],
+                table->posMax[i]);
   }
 }
 
@@ -53,6 +53,11 @@ struct _ConcExpr {
   int ref_count;
   NodeType type;
   double value;
+  // How many levels of structure are below this node.
+  int height;
+  // The last symbolic expression this node was generalized into, so
+  // that merging it in again can be skipped.
+  SymbExpr* merged_into;
   struct {
     ShadowOpInfo* op;
     int nargs;
@@ -65,6 +70,44 @@ Xarray_H(Group, GroupList);
 
 extern Stack* leafCExprs;
 
+// When a branch expression is made, each node in its structure, down
+// to max_expr_block_depth, gets a small index, in preorder. Groups
+// borrowed from a child at the bottom of that can reach deeper, so
+// the paths down to those members get indices too, after the rest.
+// The structure only ever loses nodes after that, and groups only
+// ever split, so the indices stay good for the life of the
+// expression. Positions in the expression's groups and range tables
+// are all in there, so looking one up is a
+// walk down this array instead of through the expression tree, and a
+// matching concrete expression can be flattened into the same order
+// once, with flattenConcExpr, and then just indexed into.
+typedef struct _posIndex {
+  int numNodes;
+  // The position of the node at each index.
+  NodePos* positions;
+  // The index of each node's i'th child is at [index *
+  // MAX_BRANCH_ARGS + i], or -1 if it has no such child.
+  int* children;
+} PosIndex;
+
+// The problematic ranges and example inputs of an expression's
+// variables (see initializeProblematicRangesAndExample), stored
+// column by column so that they can all be updated in one tight
+// loop. Live entries are packed at the front of the columns, in the
+// order they were added.
+typedef struct _RangeTable {
+  int numEntries;
+  // The position index that each entry is for.
+  int* entryNode;
+  // The entry for each position index, or -1 if it doesn't have one.
+  int* entryOf;
+  double* negMin;
+  double* negMax;
+  double* posMin;
+  double* posMax;
+  double* example;
+} RangeTable;
+
 struct _SymbExpr {
   NodeType type;
   double constVal;
@@ -74,8 +117,8 @@ struct _SymbExpr {
     int nargs;
     SymbExpr** args;
     GroupList groups;
-    VgHashTable* varProblematicRanges;
-    VgHashTable* exampleProblematicArgs;
+    PosIndex posIndex;
+    RangeTable ranges;
   } branch;
 };
 
@@ -84,8 +127,7 @@ typedef struct _varMap {
   int nextVarIdx;
 } VarMap;
 
-void recursivelyOwnConcExpr(ConcExpr* expr, int depth);
-void recursivelyDisownConcExpr(ConcExpr* expr, int depth);
+void ownConcExpr(ConcExpr* expr);
 void initExprAllocator(void);
 ConcExpr* mkLeafConcExpr(double value);
 ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op, int nargs, ConcExpr** args);
@@ -97,20 +139,34 @@ SymbExpr* concreteToSymbolic(ConcExpr* cexpr);
 int hasRepeatedVars(SymbExpr* expr);
 SymbExpr* varSwallow(SymbExpr* expr);
 
+void buildPosIndex(SymbExpr* symbExpr);
+// The index of pos in symbExpr, or -1 if it wasn't in the
+// expression's structure or groups when it was made.
+int posIndexOf(SymbExpr* symbExpr, NodePos pos);
+// Fill out, which should have room for every node in symbExpr's
+// index, with the node of cexpr at each index's position, or NULL if
+// cexpr doesn't have one there.
+void flattenConcExpr(SymbExpr* symbExpr, ConcExpr* cexpr, ConcExpr** out);
+// Same, but for the nodes of symbExpr that are still there.
+void flattenSymbExpr(SymbExpr* symbExpr, SymbExpr** out);
+
 void initializeProblematicRangesAndExample(SymbExpr* symbExpr);
-void addRangeEntryCopy(VgHashTable* rangeMap, NodePos position, RangeRecord* original);
-void addInitialRangeEntry(VgHashTable* rangeMap, NodePos position);
-void addExampleEntryCopy(VgHashTable* exampleTable,
+void addRangeEntryCopy(SymbExpr* symbExpr, NodePos position, RangeRecord* original);
+void addInitialRangeEntry(SymbExpr* symbExpr, NodePos position);
+void addExampleEntryCopy(SymbExpr* symbExpr,
                          NodePos position, double original);
-void addInitialExampleEntry(VgHashTable* exampleMap, NodePos position);
+void addInitialExampleEntry(SymbExpr* symbExpr, NodePos position);
 void updateProblematicRanges(SymbExpr* symbExpr, ConcExpr* cexpr);
-RangeRecord* lookupRangeRecord(VgHashTable* rangeMap, NodePos position);
-double lookupExampleInput(VgHashTable* exampleMap, NodePos position);
+// Copy the range table entry for position into out, returning False
+// if there isn't one.
+Bool lookupRangeRecord(SymbExpr* symbExpr, NodePos position,
+                       RangeRecord* out);
+double lookupExampleInput(SymbExpr* symbExpr, NodePos position);
 void getRangesAndExample(RangeRecord** totalRangesOut,
                          RangeRecord** problematicRangesOut,
                          double** exampleInputOut,
                          SymbExpr* expr, int num_vars);
-void ppRangeTable(VgHashTable* rangeTable);
+void ppRangeTable(SymbExpr* symbExpr);
 
 void ppEquivGroup(Group group);
 void ppEquivGroups(GroupList groups);
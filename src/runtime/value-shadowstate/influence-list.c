@@ -31,31 +31,26 @@
 #include "pub_tool_mallocfree.h"
 #include "pub_tool_libcassert.h"
 #include "pub_tool_libcprint.h"
+#include "pub_tool_libcbase.h"
 
 #include "../../options.h"
 #include "../../helper/runtime-util.h"
 
-InfluenceList pool = NULL;
-
 InfluenceList mkInfluenceList(void){
-  InfluenceList result;
-  if (pool == NULL){
-    result =
-      VG_(malloc)("influence list", sizeof(struct _influenceList));
-    result->data =
-      VG_(malloc)("influence list data", sizeof(ShadowOpInfo*) * max_influences);
-  } else {
-    result = pool;
-    pool = pool->next;
-  }
-  result->next = NULL;
+  InfluenceList result =
+    VG_(malloc)("influence list",
+                sizeof(struct _influenceList) +
+                sizeof(ShadowOpInfo*) * max_influences);
+  result->data = (ShadowOpInfo**)(result + 1);
+  result->ref_count = 0;
   result->length = 0;
+  result->hash = 0;
   return result;
 }
-
 void freeInfluenceList(InfluenceList il){
-  il->next = pool;
-  pool = il;
+  if (il != NULL){
+    VG_(free)(il);
+  }
 }
 
 inline int score(ShadowOpInfo* info);
@@ -63,57 +58,222 @@ inline int score(ShadowOpInfo* info){
   return info->agg.local_error.max_error;
 }
 
+// Every live influence list, in an open addressed table keyed on the
+// contents of the list.
+#define INITIAL_INTERN_CAPACITY 1024
+static InfluenceList* internTable = NULL;
+static SizeT internCapacity = 0;
+static SizeT internCount = 0;
+
+static UWord hashInfluences(ShadowOpInfo** data, int length){
+  UWord hash = length;
+  for(int i = 0; i < length; ++i){
+    hash = hash * 31 + ((UWord)data[i] >> 3);
+  }
+  return hash;
+}
+
+static SizeT internSlotFor(UWord hash, ShadowOpInfo** data, int length){
+  SizeT mask = internCapacity - 1;
+  SizeT slot = hash & mask;
+  while(internTable[slot] != NULL){
+    InfluenceList existing = internTable[slot];
+    if (existing->hash == hash && existing->length == length &&
+        VG_(memcmp)(existing->data, data,
+                    sizeof(ShadowOpInfo*) * length) == 0){
+      break;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+static void growInternTable(void){
+  InfluenceList* oldTable = internTable;
+  SizeT oldCapacity = internCapacity;
+  internCapacity =
+    oldCapacity == 0 ? INITIAL_INTERN_CAPACITY : oldCapacity * 2;
+  internTable = VG_(malloc)("influence intern table",
+                            sizeof(InfluenceList) * internCapacity);
+  VG_(memset)(internTable, 0, sizeof(InfluenceList) * internCapacity);
+  for(SizeT i = 0; i < oldCapacity; ++i){
+    InfluenceList il = oldTable[i];
+    if (il != NULL){
+      internTable[internSlotFor(il->hash, il->data, il->length)] = il;
+    }
+  }
+  if (oldTable != NULL){
+    VG_(free)(oldTable);
+  }
+}
+
+// A new reference to the one list with exactly these (sorted)
+// influences, making it if it doesn't exist yet.
+static InfluenceList internInfluences(ShadowOpInfo** data, int length){
+  if (internCount * 2 >= internCapacity){
+    growInternTable();
+  }
+  UWord hash = hashInfluences(data, length);
+  SizeT slot = internSlotFor(hash, data, length);
+  if (internTable[slot] == NULL){
+    InfluenceList result =
+      VG_(malloc)("interned influence list",
+                  sizeof(struct _influenceList) +
+                  sizeof(ShadowOpInfo*) * length);
+    result->data = (ShadowOpInfo**)(result + 1);
+    VG_(memcpy)(result->data, data, sizeof(ShadowOpInfo*) * length);
+    result->ref_count = 0;
+    result->length = length;
+    result->hash = hash;
+    internTable[slot] = result;
+    internCount++;
+  }
+  return ownInfluenceList(internTable[slot]);
+}
+
+// Take il out of the intern table, shifting back any entries after
+// it in its probe run that would otherwise become unreachable.
+static void unintern(InfluenceList il){
+  SizeT mask = internCapacity - 1;
+  SizeT slot = il->hash & mask;
+  while(internTable[slot] != il){
+    tl_assert(internTable[slot] != NULL);
+    slot = (slot + 1) & mask;
+  }
+  SizeT hole = slot;
+  for(SizeT next = (hole + 1) & mask; internTable[next] != NULL;
+      next = (next + 1) & mask){
+    SizeT home = internTable[next]->hash & mask;
+    // Entries whose home is cyclically in (hole, next] are already
+    // as close to it as they can get.
+    if (((next - home) & mask) >= ((next - hole) & mask)){
+      internTable[hole] = internTable[next];
+      hole = next;
+    }
+  }
+  internTable[hole] = NULL;
+  internCount--;
+}
+
+InfluenceList ownInfluenceList(InfluenceList il){
+  if (il != NULL){
+    il->ref_count++;
+  }
+  return il;
+}
+void disownInfluenceList(InfluenceList il){
+  if (il == NULL) return;
+  tl_assert(il->ref_count > 0);
+  il->ref_count--;
+  if (il->ref_count == 0){
+    unintern(il);
+    VG_(free)(il);
+  }
+}
+
+// Since lists are interned, a merge is a function of its input
+// pointers, so we remember recent ones in a direct mapped cache. The
+// cache holds a reference to every list in it, so none of them can
+// be freed and have their address reused while they're cached; it
+// drops them when the entry is replaced.
+#define UNION_CACHE_SIZE 4096
+typedef struct _unionCacheEntry {
+  InfluenceList il1;
+  InfluenceList il2;
+  ShadowOpInfo* extra;
+  InfluenceList result;
+} UnionCacheEntry;
+static UnionCacheEntry unionCache[UNION_CACHE_SIZE];
+
+static UnionCacheEntry* unionCacheEntryFor(InfluenceList il1,
+                                           InfluenceList il2,
+                                           ShadowOpInfo* extra){
+  UWord hash = ((UWord)il1 >> 3) ^ ((UWord)il2 >> 5) ^ ((UWord)extra >> 4);
+  return &(unionCache[hash & (UNION_CACHE_SIZE - 1)]);
+}
+
 InfluenceList mergeInfluences(InfluenceList il1, InfluenceList il2,
                               ShadowOpInfo* extra){
-  if (il1 == NULL && il2 == NULL && extra == NULL) return NULL;
-  InfluenceList result = mkInfluenceList();
+  int length1 = il1 == NULL ? 0 : il1->length;
+  int length2 = il2 == NULL ? 0 : il2->length;
+  // Most values only have a couple of influences, and most ops don't
+  // add one, so the merge usually comes out the same as one of its
+  // inputs. Catch the easy cases of that before doing any work.
+  if (extra == NULL){
+    if (length2 == 0 || il1 == il2){
+      return length1 == 0 ? NULL : ownInfluenceList(il1);
+    } else if (length1 == 0){
+      return ownInfluenceList(il2);
+    }
+  }
+  // Merging is symmetric, so put the inputs in a canonical order to
+  // get more out of the cache.
+  if ((UWord)il1 < (UWord)il2){
+    InfluenceList tmpList = il1;
+    il1 = il2;
+    il2 = tmpList;
+    int tmpLength = length1;
+    length1 = length2;
+    length2 = tmpLength;
+  }
+  UnionCacheEntry* entry = unionCacheEntryFor(il1, il2, extra);
+  if (entry->result != NULL &&
+      entry->il1 == il1 && entry->il2 == il2 && entry->extra == extra){
+    return ownInfluenceList(entry->result);
+  }
+  ShadowOpInfo* originalExtra = extra;
+
+  // Otherwise, merge the (sorted) inputs into a scratch buffer,
+  // dropping duplicates, which will be adjacent.
+  static ShadowOpInfo** merged = NULL;
+  if (merged == NULL){
+    merged = VG_(malloc)("merged influences",
+                         sizeof(ShadowOpInfo*) * max_influences);
+  }
+  int length = 0;
   int i = 0;
   int j = 0;
-  while(((il1 != NULL && i < il1->length) ||
-         (il2 != NULL && j < il2->length) ||
-         extra != NULL) &&
-        result->length < max_influences){
-    if (il1 != NULL && i < il1->length &&
-        (il2 == NULL || j >= il2->length || cmpInfo(il1->data[i], il2->data[j]) >= 0) &&
-        (extra == NULL || cmpInfo(il1->data[i], extra) >= 0)){
-      if (result->length == 0 || result->data[result->length-1] != il1->data[i]){
-        result->data[result->length++] = il1->data[i];
-      }
-      i++;
-    } else if (il2 != NULL && j < il2->length &&
-               (il1 == NULL || i >= il1->length ||
-                cmpInfo(il2->data[j], il1->data[i]) >= 0) &&
-               (extra == NULL || cmpInfo(il2->data[j], extra) >= 0)){
-      if (result->length == 0 || result->data[result->length-1] != il2->data[j]){
-        result->data[result->length++] = il2->data[j];
+  while((i < length1 || j < length2 || extra != NULL) &&
+        length < max_influences){
+    ShadowOpInfo* next;
+    if (i < length1 &&
+        (j >= length2 || cmpInfo(il1->data[i], il2->data[j]) >= 0)){
+      next = il1->data[i];
+      if (extra != NULL && cmpInfo(extra, next) > 0){
+        next = extra;
+        extra = NULL;
+      } else {
+        i++;
       }
-      j++;
-    } else if (extra != NULL &&
-               (il1 == NULL || i >= il1->length || cmpInfo(extra, il1->data[i]) >= 0) &&
-               (il2 == NULL || j >= il2->length || cmpInfo(extra, il2->data[j]) >= 0)){
-      if (result->length == 0 || result->data[result->length-1] != extra){
-        result->data[result->length++] = extra;
+    } else if (j < length2){
+      next = il2->data[j];
+      if (extra != NULL && cmpInfo(extra, next) > 0){
+        next = extra;
+        extra = NULL;
+      } else {
+        j++;
       }
-      extra = NULL;
     } else {
-      VG_(printf)("cmpInfo(il2->data[j], il1->data[i]) : %d\n",
-                  cmpInfo(il2->data[j], il1->data[i]));
-      VG_(printf)("il2->data[j]: %p\nil1->data[i]: %p\n",
-                  il2->data[j], il1->data[i]);
-      VG_(printf)("extra: %p\n", extra);
-      VG_(printf)("i: %d, il1: %p", i, il1);
-      if (il1 != NULL){
-        VG_(printf)(" il1->length : %d", il1->length);
-      }
-      VG_(printf)("\n");
-      VG_(printf)("j: %d, il2: %p", j, il2);
-      if (il2 != NULL){
-        VG_(printf)(" il2->length : %d", il2->length);
-      }
-      VG_(printf)("\n");
-      tl_assert(0);
+      next = extra;
+      extra = NULL;
+    }
+    if (length == 0 || merged[length-1] != next){
+      merged[length++] = next;
     }
   }
+  InfluenceList result = internInfluences(merged, length);
+  // Take the new references before dropping the old ones, in case
+  // they're the same lists.
+  ownInfluenceList(il1);
+  ownInfluenceList(il2);
+  ownInfluenceList(result);
+  disownInfluenceList(entry->il1);
+  disownInfluenceList(entry->il2);
+  disownInfluenceList(entry->result);
+  entry->il1 = il1;
+  entry->il2 = il2;
+  entry->extra = originalExtra;
+  entry->result = result;
   return result;
 }
 
@@ -32,14 +32,31 @@
 
 #include "../op-shadowstate/shadowop-info.h"
 
+// The influence lists that values and marks carry around are
+// interned: there is only ever one list with a given set of
+// influences, so a list pointer identifies its set, and lists are
+// never changed once they've been made. They're reference counted,
+// so copying a value's influences is just taking another reference,
+// and a list leaves the intern table when its last reference goes.
+// See internInfluences.
 typedef struct _influenceList{
-  struct _influenceList* next;
+  UWord ref_count;
   int length;
+  UWord hash;
+  // Points just past this struct, into the same block.
   ShadowOpInfo** data;
 } *InfluenceList;
 
+// Both of these accept NULL, the empty list.
+InfluenceList ownInfluenceList(InfluenceList il);
+void disownInfluenceList(InfluenceList il);
+
+// A fresh, uninterned list with room for max_influences, for
+// building filtered lists at output time. These can't be merged or
+// owned, and are freed with freeInfluenceList, which accepts NULL.
 InfluenceList mkInfluenceList(void);
 void freeInfluenceList(InfluenceList il);
+// Returns a new reference.
 InfluenceList mergeInfluences(InfluenceList il1, InfluenceList il2,
                               ShadowOpInfo* extra);
 void ppInfluences(InfluenceList influences);
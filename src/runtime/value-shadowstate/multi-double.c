@@ -0,0 +1,215 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie         multi-double.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "multi-double.h"
+
+#include <math.h>
+
+// Turns the m terms in x (which get clobbered) into an n-part
+// expansion in r. Each pass sweeps the terms from smallest to largest
+// with TwoSum, which leaves their (approximate) total in the first
+// slot and the exact leftovers behind it, so the only error is in
+// folding together whatever is left past the nth part at the end.
+static void mdRenormalize(double* r, double* x, int m, int n){
+  int k = 0;
+  for(int pass = 0; pass < m && k < n; ++pass){
+    double s = x[m - 1];
+    for(int i = m - 2; i >= k; --i){
+      s = twoSum(x[i], s, &(x[i + 1]));
+    }
+    x[k] = s;
+    // If the terms cancelled out to zero at this magnitude, go around
+    // again on the leftovers instead of putting a zero in the middle
+    // of the expansion.
+    if (s != 0){
+      k++;
+    }
+  }
+  double tail = 0;
+  for(int i = k; i < m; ++i){
+    tail += x[i];
+  }
+  for(int i = 0; i < n; ++i){
+    if (i < k){
+      r[i] = x[i];
+    } else {
+      r[i] = 0;
+    }
+  }
+  if (k < n){
+    r[k] = tail;
+  } else {
+    r[n - 1] += tail;
+  }
+}
+
+// The error-free transformations don't know what to do with
+// infinities and NaNs, so when the leading parts of an operation
+// already give something that isn't finite, that's our answer.
+static Bool mdSpecial(double* r, double leading, int n){
+  if (leading - leading == 0){
+    return False;
+  }
+  mdSetD(r, leading, n);
+  return True;
+}
+
+void mdSetD(double* r, double d, int n){
+  r[0] = d;
+  for(int i = 1; i < n; ++i){
+    r[i] = 0;
+  }
+}
+double mdGetD(const double* a, int n){
+  double s = a[n - 1];
+  for(int i = n - 2; i >= 0; --i){
+    s = a[i] + s;
+  }
+  return s;
+}
+void mdCopy(double* r, const double* a, int n){
+  for(int i = 0; i < n; ++i){
+    r[i] = a[i];
+  }
+}
+Bool mdIsNaN(const double* a){
+  return a[0] != a[0];
+}
+int mdCmp(const double* a, const double* b, int n){
+  double diff[MAX_MD_PARTS];
+  mdSub(diff, a, b, n);
+  if (diff[0] > 0){
+    return 1;
+  } else if (diff[0] < 0){
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+void mdNeg(double* r, const double* a, int n){
+  for(int i = 0; i < n; ++i){
+    r[i] = -a[i];
+  }
+}
+void mdAbs(double* r, const double* a, int n){
+  if (a[0] < 0){
+    mdNeg(r, a, n);
+  } else {
+    mdCopy(r, a, n);
+  }
+}
+void mdAdd(double* r, const double* a, const double* b, int n){
+  if (mdSpecial(r, a[0] + b[0], n)) return;
+  double terms[2 * MAX_MD_PARTS];
+  for(int i = 0; i < n; ++i){
+    terms[2 * i] = a[i];
+    terms[2 * i + 1] = b[i];
+  }
+  mdRenormalize(r, terms, 2 * n, n);
+}
+void mdSub(double* r, const double* a, const double* b, int n){
+  double negB[MAX_MD_PARTS];
+  mdNeg(negB, b, n);
+  mdAdd(r, a, negB, n);
+}
+void mdMul(double* r, const double* a, const double* b, int n){
+  if (mdSpecial(r, a[0] * b[0], n)) return;
+  double terms[MAX_MD_PARTS * (MAX_MD_PARTS + 1) + MAX_MD_PARTS];
+  int m = 0;
+  // Partial products which can land in the first n parts are
+  // computed exactly, in rough order of significance...
+  for(int order = 0; order < n; ++order){
+    for(int i = 0; i <= order; ++i){
+      terms[m] = twoProd(a[i], b[order - i], &(terms[m + 1]));
+      m += 2;
+    }
+  }
+  // ...and the next order down only needs to be approximate.
+  for(int i = 1; i < n; ++i){
+    terms[m++] = a[i] * b[n - i];
+  }
+  mdRenormalize(r, terms, m, n);
+}
+void mdMulD(double* r, const double* a, double b, int n){
+  if (mdSpecial(r, a[0] * b, n)) return;
+  double terms[2 * MAX_MD_PARTS];
+  for(int i = 0; i < n; ++i){
+    terms[2 * i] = twoProd(a[i], b, &(terms[2 * i + 1]));
+  }
+  mdRenormalize(r, terms, 2 * n, n);
+}
+// Schoolbook long division: each step divides the remainder by the
+// leading part of the divisor to get one more double's worth of
+// quotient.
+void mdDiv(double* r, const double* a, const double* b, int n){
+  if (mdSpecial(r, a[0] / b[0], n)) return;
+  double quotient[MAX_MD_PARTS + 1];
+  double remainder[MAX_MD_PARTS];
+  double product[MAX_MD_PARTS];
+  mdCopy(remainder, a, n);
+  for(int i = 0; i <= n; ++i){
+    quotient[i] = remainder[0] / b[0];
+    if (i < n){
+      mdMulD(product, b, quotient[i], n);
+      mdSub(remainder, remainder, product, n);
+    }
+  }
+  mdRenormalize(r, quotient, n + 1, n);
+}
+// Newton's method, starting from the hardware square root. We hold
+// the derivative fixed at the starting point, so each iteration only
+// gains another double's worth of precision, but saves a full
+// division each time.
+void mdSqrt(double* r, const double* a, int n){
+  if (a[0] == 0){
+    mdSetD(r, a[0], n);
+    return;
+  }
+  double x0 = sqrt(a[0]);
+  if (mdSpecial(r, x0, n)) return;
+  double halfRecip = 0.5 / x0;
+  double x[MAX_MD_PARTS];
+  double square[MAX_MD_PARTS];
+  double residual[MAX_MD_PARTS];
+  mdSetD(x, x0, n);
+  for(int i = 1; i < n; ++i){
+    mdMul(square, x, x, n);
+    mdSub(residual, a, square, n);
+    mdMulD(residual, residual, halfRecip, n);
+    mdAdd(x, x, residual, n);
+  }
+  mdCopy(r, x, n);
+}
+void mdFma(double* r, const double* a, const double* b,
+           const double* c, int n){
+  double product[MAX_MD_PARTS];
+  mdMul(product, a, b, n);
+  mdAdd(r, product, c, n);
+}
@@ -0,0 +1,100 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie         multi-double.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+// This is a small library for "multi-double" arithmetic: numbers
+// represented as the unevaluated sum of a few doubles, largest
+// magnitude first. With two parts this is double-double arithmetic
+// (about 106 bits of precision), and with four it's quad-double
+// (about 212 bits). Everything is built on the error-free
+// transformations TwoSum and TwoProd, so it never has to allocate,
+// and each op is a few dozen to a few hundred flops instead of a
+// trip through MPFR.
+
+#ifndef _MULTI_DOUBLE_H
+#define _MULTI_DOUBLE_H
+
+#include "pub_tool_basics.h"
+
+#define MAX_MD_PARTS 4
+
+void mdSetD(double* r, double d, int n);
+double mdGetD(const double* a, int n);
+void mdCopy(double* r, const double* a, int n);
+Bool mdIsNaN(const double* a);
+int mdCmp(const double* a, const double* b, int n);
+
+void mdNeg(double* r, const double* a, int n);
+void mdAbs(double* r, const double* a, int n);
+void mdAdd(double* r, const double* a, const double* b, int n);
+void mdSub(double* r, const double* a, const double* b, int n);
+void mdMul(double* r, const double* a, const double* b, int n);
+void mdMulD(double* r, const double* a, double b, int n);
+void mdDiv(double* r, const double* a, const double* b, int n);
+void mdSqrt(double* r, const double* a, int n);
+void mdFma(double* r, const double* a, const double* b,
+           const double* c, int n);
+
+inline double twoSum(double a, double b, double* err);
+inline double twoProd(double a, double b, double* err);
+
+// Computes a + b, and puts the rounding error of that sum in err, so
+// that a + b == result + err exactly.
+__attribute__((always_inline))
+inline
+double twoSum(double a, double b, double* err){
+  double s = a + b;
+  double bb = s - a;
+  *err = (a - (s - bb)) + (b - bb);
+  return s;
+}
+// Computes a * b, and puts the rounding error of that product in err,
+// so that a * b == result + err exactly (barring overflow and
+// underflow).
+__attribute__((always_inline))
+inline
+double twoProd(double a, double b, double* err){
+  double p = a * b;
+#ifdef __FMA__
+  *err = __builtin_fma(a, b, -p);
+#else
+  // No hardware FMA, so use Dekker's algorithm, splitting each
+  // argument into two 26-bit halves whose products are exact.
+  const double splitter = 134217729.0; // 2^27 + 1
+  double ta = splitter * a;
+  double ahi = ta - (ta - a);
+  double alo = a - ahi;
+  double tb = splitter * b;
+  double bhi = tb - (tb - b);
+  double blo = b - bhi;
+  *err = ((ahi * bhi - p) + ahi * blo + alo * bhi) + alo * blo;
+#endif
+  return p;
+}
+
+#endif
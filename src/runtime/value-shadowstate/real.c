@@ -33,8 +33,72 @@
 #include "pub_tool_libcprint.h"
 #include "pub_tool_libcassert.h"
 
+static struct _RealStruct scratchReals[NUM_SCRATCH_REALS];
+static mpfr_t conversionScratch;
+// How many bytes of limbs an inline real needs at the current
+// precision. Fixed once the options are parsed.
+static SizeT inlineLimbBytes;
+
+void initReals(void){
+  for(int i = 0; i < NUM_SCRATCH_REALS; ++i){
+    mpfr_init2(scratchReals[i].mpfr_val, precision);
+  }
+  mpfr_init2(conversionScratch, precision);
+  if (real_backend != Rb_MPFR){
+    inlineLimbBytes = 0;
+  } else {
+    #ifdef USE_MPFR
+    inlineLimbBytes = mpfr_custom_get_size(precision);
+    #else
+    inlineLimbBytes = 0;
+    #endif
+  }
+}
+Real getScratchReal(int idx){
+  tl_assert(idx < NUM_SCRATCH_REALS);
+  return &(scratchReals[idx]);
+}
+// Get the value of a real into an MPFR value, regardless of
+// backend. For the multi-double backends, this is exact as long as
+// dest has enough precision to cover the spread of the parts.
+void realToMPFR(mpfr_ptr dest, Real src){
+  if (real_backend == Rb_MPFR){
+    mpfr_set(dest, src->mpfr_val, MPFR_RNDN);
+  } else {
+    mpfr_set_d(dest, src->md_val[0], MPFR_RNDN);
+    for(int i = 1; i < NUM_MD_PARTS; ++i){
+      mpfr_add_d(dest, dest, src->md_val[i], MPFR_RNDN);
+    }
+  }
+}
+// Set a real from an MPFR value. For the multi-double backends, this
+// peels off one double at a time, rounding off whatever's left past
+// the last part.
+void realFromMPFR(Real dest, mpfr_srcptr src){
+  if (real_backend == Rb_MPFR){
+    if (adaptive_precision){
+      setRealPrecision(dest, precision);
+    }
+    mpfr_set(dest->mpfr_val, src, MPFR_RNDN);
+  } else {
+    mpfr_set(conversionScratch, src, MPFR_RNDN);
+    for(int i = 0; i < NUM_MD_PARTS; ++i){
+      dest->md_val[i] = mpfr_get_d(conversionScratch, MPFR_RNDN);
+      if (i == 0 && dest->md_val[0] - dest->md_val[0] != 0){
+        mdSetD(dest->md_val, dest->md_val[0], NUM_MD_PARTS);
+        break;
+      }
+      mpfr_sub_d(conversionScratch, conversionScratch, dest->md_val[i], MPFR_RNDN);
+    }
+  }
+}
+
 Real mkReal(void){
   Real result = VG_(malloc)("real", sizeof(struct _RealStruct));
+  if (real_backend != Rb_MPFR){
+    mdSetD(result->md_val, 0.0, NUM_MD_PARTS);
+    return result;
+  }
   #ifdef USE_MPFR
   mpfr_init2(result->mpfr_val, precision);
   #else
@@ -42,24 +106,76 @@ Real mkReal(void){
   #endif
   return result;
 }
+SizeT inlineRealSize(void){
+  return sizeof(struct _RealStruct) + inlineLimbBytes;
+}
+// These are never cleared. Their limbs are sized for the full
+// precision up front, since MPFR can't reallocate limbs it doesn't
+// own, so with adaptive precision setRealPrecision can move them
+// anywhere up to that without touching the allocation.
+Real initInlineReal(void* mem){
+  Real result = mem;
+  if (real_backend != Rb_MPFR){
+    mdSetD(result->md_val, 0.0, NUM_MD_PARTS);
+    return result;
+  }
+  #ifdef USE_MPFR
+  void* limbs = (char*)mem + sizeof(struct _RealStruct);
+  mpfr_custom_init(limbs, precision);
+  mpfr_custom_init_set(result->mpfr_val, MPFR_ZERO_KIND, 0,
+                       precision, limbs);
+  #else
+  mpf_init2(result->mpf_val, precision);
+  #endif
+  return result;
+}
+#ifdef USE_MPFR
+// This re-initializes the real over its own limbs, so it's only good
+// for inline reals; reals from mkReal belong to MPFR, and have to
+// keep the precision they were made with.
+void setRealPrecision(Real r, mpfr_prec_t prec){
+  if (prec > precision){
+    prec = precision;
+  } else if (prec < MPFR_PREC_MIN){
+    prec = MPFR_PREC_MIN;
+  }
+  if (mpfr_get_prec(r->mpfr_val) == prec){
+    return;
+  }
+  mpfr_custom_init_set(r->mpfr_val, MPFR_NAN_KIND, 0, prec,
+                       mpfr_custom_get_significand(r->mpfr_val));
+}
+#endif
 void setReal(Real r, double bytes){
+  if (real_backend != Rb_MPFR){
+    mdSetD(r->md_val, bytes, NUM_MD_PARTS);
+    return;
+  }
   #ifdef USE_MPFR
+  if (adaptive_precision){
+    setRealPrecision(r, 53);
+  }
   mpfr_set_d(r->mpfr_val, bytes, MPFR_RNDN);
   #else
   mpf_set_d(r->mpf_val, bytes);
   #endif
 }
 void freeReal(Real real){
-  #ifdef USE_MPFR
-  mpfr_clear(real->mpfr_val);
-  #else
-  mpf_clear(real->mpf_val);
-  #endif
+  if (real_backend == Rb_MPFR){
+    #ifdef USE_MPFR
+    mpfr_clear(real->mpfr_val);
+    #else
+    mpf_clear(real->mpf_val);
+    #endif
+  }
   VG_(free)(real);
 }
 
 double getDouble(Real real){
   if (no_reals) return 0.0;
+  if (real_backend != Rb_MPFR){
+    return mdGetD(real->md_val, NUM_MD_PARTS);
+  }
   #ifdef USE_MPFR
   return mpfr_get_d(real->mpfr_val, MPFR_RNDN);
   #else
@@ -69,6 +185,9 @@ double getDouble(Real real){
 
 int isNaN(Real real){
   if (no_reals) return 0;
+  if (real_backend != Rb_MPFR){
+    return mdIsNaN(real->md_val);
+  }
   #ifdef USE_MPFR
   return mpfr_nan_p(real->mpfr_val);
   #else
@@ -76,6 +195,9 @@ int isNaN(Real real){
   #endif
 }
 int realCompare(Real real1, Real real2){
+  if (real_backend != Rb_MPFR){
+    return mdCmp(real1->md_val, real2->md_val, NUM_MD_PARTS);
+  }
   #ifdef USE_MPFR
   return mpfr_cmp(real1->mpfr_val, real2->mpfr_val);
   #else
@@ -84,18 +206,33 @@ int realCompare(Real real1, Real real2){
 }
 
 void copyReal(Real src, Real dest){
+  if (real_backend != Rb_MPFR){
+    mdCopy(dest->md_val, src->md_val, NUM_MD_PARTS);
+    return;
+  }
   #ifdef USE_MPFR
+  if (adaptive_precision){
+    setRealPrecision(dest, mpfr_get_prec(src->mpfr_val));
+  }
   mpfr_set(dest->mpfr_val, src->mpfr_val, MPFR_RNDN);
   #else
   mpf_set(dest->mpf_val, src->mpf_val);
   #endif
 }
 
+static void printBBufConversionScratch(BBuf* buf){
+  char* shadowValStr;
+  mpfr_exp_t shadowValExpt;
+
+  shadowValStr = mpfr_get_str(NULL, &shadowValExpt, 10, longprint_len, conversionScratch, MPFR_RNDN);
+  printBBuf(buf, "%c.%se%ld", shadowValStr[0], shadowValStr+1, shadowValExpt-1);
+  mpfr_free_str(shadowValStr);
+}
+// The conversion scratch has the same precision a fresh real would,
+// so there's no need to make one just to print a double.
 void printBBufFloatAsReal(BBuf* buf, double val){
-  Real r_val = mkReal();
-  setReal(r_val, val);
-  printBBufReal(buf, r_val);
-  freeReal(r_val);
+  mpfr_set_d(conversionScratch, val, MPFR_RNDN);
+  printBBufConversionScratch(buf);
 }
 void pFloat(BBuf* buf, double val) {
   if (fullprec_exprs){
@@ -106,12 +243,8 @@ void pFloat(BBuf* buf, double val) {
 }
 
 void printBBufReal(BBuf* buf, Real real){
-  char* shadowValStr;
-  mpfr_exp_t shadowValExpt;
-
-  shadowValStr = mpfr_get_str(NULL, &shadowValExpt, 10, longprint_len, real->mpfr_val, MPFR_RNDN);
-  printBBuf(buf, "%c.%se%ld", shadowValStr[0], shadowValStr+1, shadowValExpt-1);
-  mpfr_free_str(shadowValStr);
+  realToMPFR(conversionScratch, real);
+  printBBufConversionScratch(buf);
 }
 
 void printReal(Real real){
@@ -119,7 +252,8 @@ void printReal(Real real){
   char* shadowValStr;
   mpfr_exp_t shadowValExpt;
 
-  shadowValStr = mpfr_get_str(NULL, &shadowValExpt, 10, longprint_len, real->mpfr_val, MPFR_RNDN);
+  realToMPFR(conversionScratch, real);
+  shadowValStr = mpfr_get_str(NULL, &shadowValExpt, 10, longprint_len, conversionScratch, MPFR_RNDN);
   VG_(printf)("%c.%se%ld", shadowValStr[0], shadowValStr+1, shadowValExpt-1);
   mpfr_free_str(shadowValStr);
   #else
@@ -40,6 +40,7 @@
 #endif
 
 #include "pub_tool_basics.h"
+#include "multi-double.h"
 
 typedef struct _RealStruct{
   #ifdef USE_MPFR
@@ -47,11 +48,41 @@ typedef struct _RealStruct{
   #else
   mpf_t mpf_val;
   #endif
+  // When we're using the double-double or quad-double backends, the
+  // value lives here instead, and the MPFR value is never initialized.
+  double md_val[MAX_MD_PARTS];
 } *Real;
 
+// How many parts the multi-double backends use.
+#define NUM_MD_PARTS (real_backend == Rb_DD ? 2 : 4)
+
+// Operations that the multi-double backends don't implement
+// themselves get run in MPFR on scratch copies of their values, so
+// we keep a few scratch reals around that always have MPFR values.
+#define NUM_SCRATCH_REALS 8
+
+void initReals(void);
+Real getScratchReal(int idx);
+void realToMPFR(mpfr_ptr dest, Real src);
+void realFromMPFR(Real dest, mpfr_srcptr src);
+
 Real mkReal(void);
+// Shadow values carry their real inline, with the limbs laid out
+// right after it, so the whole thing is one block. These give the
+// size of that inline real, and set one up at a given address.
+SizeT inlineRealSize(void);
+Real initInlineReal(void* mem);
 void setReal(Real r, double bytes);
 
+#ifdef USE_MPFR
+// Under --adaptive-precision, an MPFR real only carries as many bits
+// as it needs to hold its value exactly, capped at --precision.
+// Change the precision of a shadow value's inline real, throwing away
+// its value. The limbs are always sized for --precision, so this
+// never allocates.
+void setRealPrecision(Real r, mpfr_prec_t prec);
+#endif
+
 double getDouble(Real real);
 int isNaN(Real real);
 int realCompare(Real real1, Real real2);
@@ -69,7 +100,14 @@ __attribute__((always_inline))
 inline
 void setReal_fast(Real r, double bytes){
   if (no_reals) return;
+  if (real_backend != Rb_MPFR){
+    mdSetD(r->md_val, bytes, NUM_MD_PARTS);
+    return;
+  }
   #ifdef USE_MPFR
+  if (adaptive_precision){
+    setRealPrecision(r, 53);
+  }
   mpfr_set_d(r->mpfr_val, bytes, MPFR_RNDN);
   #else
   mpf_set_d(r->mpf_val, bytes);
@@ -41,6 +41,7 @@ VG_REGPARM(1) ShadowTemp* newShadowTemp(FloatBlocks num_blocks){
   ShadowTemp* newShadowTemp =
     VG_(perm_malloc)(sizeof(ShadowTemp), vg_alignof(ShadowTemp));
   newShadowTemp->num_blocks = num_blocks;
+  newShadowTemp->borrowed = 0;
   newShadowTemp->values =
     VG_(perm_malloc)(INT(num_blocks) * sizeof(ShadowValue*), vg_alignof(ShadowValue*));
   return newShadowTemp;
@@ -55,14 +56,46 @@ UWord hashDouble(double val){
   VG_(memcpy)(&result, &val, sizeof(UWord));
   return result;
 }
+// Shadow values are carved out of big slabs, each block holding the
+// value, its real, and the real's limbs back to back. Blocks are
+// never given back to the slab; dead values go on freedVals with
+// their reals still attached, and get reused whole from there.
+#define SHADOW_VAL_SLAB_BLOCKS 1024
+#define SHADOW_VAL_ALIGN 16
+static char* valSlabNext = NULL;
+static SizeT valSlabBlocksLeft = 0;
+static SizeT valBlockSize = 0;
+
+static SizeT roundUpToAlign(SizeT size){
+  return (size + SHADOW_VAL_ALIGN - 1) & ~((SizeT)SHADOW_VAL_ALIGN - 1);
+}
+static void* allocShadowValBlock(void){
+  if (valSlabBlocksLeft == 0){
+    if (valBlockSize == 0){
+      valBlockSize = roundUpToAlign(sizeof(ShadowValue));
+      if (!no_reals){
+        valBlockSize = roundUpToAlign(valBlockSize + inlineRealSize());
+      }
+    }
+    valSlabNext = VG_(malloc)("shadow value slab",
+                              valBlockSize * SHADOW_VAL_SLAB_BLOCKS);
+    valSlabBlocksLeft = SHADOW_VAL_SLAB_BLOCKS;
+  }
+  void* block = valSlabNext;
+  valSlabNext += valBlockSize;
+  valSlabBlocksLeft--;
+  return block;
+}
+
 inline
 ShadowValue* newShadowValue(ValueType type){
-  ShadowValue* result =
-    VG_(perm_malloc)(sizeof(ShadowValue), vg_alignof(ShadowValue));
+  ShadowValue* result = allocShadowValBlock();
   result->type = type;
   result->ref_count = 1;
+  result->influences = NULL;
   if (!no_reals){
-    result->real = mkReal();
+    result->real =
+      initInlineReal((char*)result + roundUpToAlign(sizeof(ShadowValue)));
   }
   return result;
 }
@@ -74,6 +107,12 @@ void updateRanges(RangeRecord* records, double* args, int nargs){
 
 VG_REGPARM(2) void assertValValid(const char* label, ShadowValue* val){
   tl_assert2(val->real != NULL, "%s: value is %p", label, val);
+  if (!no_reals && val->rounded_state != Rs_Stale){
+    double fresh = getDouble(val->real);
+    tl_assert2(hashDouble(fresh) == hashDouble(val->rounded) ||
+               (fresh != fresh && val->rounded != val->rounded),
+               "%s: value %p has a stale rounded double!", label, val);
+  }
 }
 VG_REGPARM(2) void assertTempValid(const char* label, ShadowTemp* temp){
   for(int i = 0; i < INT(temp->num_blocks);
@@ -39,15 +39,32 @@
 #include "../op-shadowstate/shadowop-info.h"
 #include "influence-list.h"
 
+typedef enum {
+  // The real hasn't been rounded since it was last set.
+  Rs_Stale,
+  // rounded holds the nearest double to the real.
+  Rs_Rounded,
+  // rounded holds the nearest double to the real, and the real is
+  // exactly that double.
+  Rs_Exact,
+} RoundedState;
+
 typedef struct _ShadowValue {
   // For the various data structures that will hold these values.
   struct _ShadowValue* next;
 
   UWord ref_count;
+  // Points just past this struct, into the same block; see
+  // newShadowValue.
   Real real;
   ConcExpr* expr;
   InfluenceList influences;
   ValueType type;
+  // The real rounded to a double, so that we only go through the real
+  // backend once per value no matter how many times it's asked
+  // for. Use getValDouble to get at it.
+  RoundedState rounded_state;
+  double rounded;
 } ShadowValue;
 
 typedef struct _ShadowTemp {
@@ -56,6 +73,10 @@ typedef struct _ShadowTemp {
 
   ShadowValue** values;
   FloatBlocks num_blocks;
+  // A bit for each block whose value this temp is only borrowing
+  // from the thread state, and so shouldn't disown. See
+  // inferBorrowedTemps in floattypes.c.
+  UWord borrowed;
 } ShadowTemp;
 
 // Don't assume that the new shadow temp will have NULL values!!!
@@ -78,4 +99,16 @@ VG_REGPARM(3) void assertNumBlocksNot(const char* label, ShadowTemp* temp,
 VG_REGPARM(3) void assertDynamicSize(const char* label, ShadowTemp* temp,
                                      FloatBlocks num_blocks);
 
+inline double getValDouble(ShadowValue* val);
+
+__attribute__((always_inline))
+inline
+double getValDouble(ShadowValue* val){
+  if (val->rounded_state == Rs_Stale){
+    val->rounded = getDouble(val->real);
+    val->rounded_state = Rs_Rounded;
+  }
+  return val->rounded;
+}
+
 #endif
@@ -51,25 +51,122 @@ ArgUnion computedArgs;
 ResultUnion computedResult;
 
 ShadowTemp* shadowTemps[MAX_TEMPS];
-ShadowValue* shadowThreadState[MAX_THREADS][MAX_REGISTERS];
-TableValueEntry* shadowMemTable[LARGE_PRIME];
+ShadowValue** shadowThreadState;
+ShadowMemPage* shadowMemPrimary[SM_PRIMARY_SIZE];
+VgHashTable* misalignedMemShadows;
 
 Stack* freedTemps[MAX_TEMP_BLOCKS];
+ArenaTempSlot* tempArena;
+ArenaTempSlot* tempArenaNext;
 Stack* freedVals;
+ULong liveShadowValues = 0;
 Stack* tableEntries;
 
 Word256 getBytes;
-inline TableValueEntry* mkTableEntry(void);
+inline ValueCacheEntry* mkTableEntry(void);
+
+// Everything we keep for a thread while it's not running. The
+// freelist stacks themselves are shared, since instrumentation has
+// their addresses baked in, so we just swap their contents.
+typedef struct _ThreadShadowState {
+  ShadowValue** registers;
+  StackNode* freedTempsHeads[MAX_TEMP_BLOCKS];
+  StackNode* freedValsHead;
+} ThreadShadowState;
+
+static ThreadShadowState** threadStates = NULL;
+static UInt numThreadStates = 0;
+static ThreadId curShadowThread = VG_INVALID_THREADID;
+
+static ThreadShadowState* getThreadState(ThreadId tid){
+  if (tid >= numThreadStates){
+    UInt newNumStates = numThreadStates == 0 ? 16 : numThreadStates;
+    while(newNumStates <= tid){
+      newNumStates *= 2;
+    }
+    threadStates = VG_(realloc)("thread states", threadStates,
+                                newNumStates * sizeof(ThreadShadowState*));
+    for(UInt i = numThreadStates; i < newNumStates; ++i){
+      threadStates[i] = NULL;
+    }
+    numThreadStates = newNumStates;
+  }
+  if (threadStates[tid] == NULL){
+    threadStates[tid] = VG_(calloc)("thread state", 1,
+                                    sizeof(ThreadShadowState));
+    threadStates[tid]->registers =
+      VG_(calloc)("thread state registers", MAX_REGISTERS,
+                  sizeof(ShadowValue*));
+  }
+  return threadStates[tid];
+}
+
+void switchShadowThread(ThreadId tid){
+  if (tid == curShadowThread) return;
+  tl_assert2(blockStateDirty == 0,
+             "Switched threads in the middle of a block!\n");
+  if (curShadowThread != VG_INVALID_THREADID){
+    ThreadShadowState* oldState = getThreadState(curShadowThread);
+    for(int i = 0; i < MAX_TEMP_BLOCKS; ++i){
+      oldState->freedTempsHeads[i] = freedTemps[i]->head;
+    }
+    oldState->freedValsHead = freedVals->head;
+  }
+  ThreadShadowState* newState = getThreadState(tid);
+  for(int i = 0; i < MAX_TEMP_BLOCKS; ++i){
+    freedTemps[i]->head = newState->freedTempsHeads[i];
+  }
+  freedVals->head = newState->freedValsHead;
+  shadowThreadState = newState->registers;
+  curShadowThread = tid;
+}
+
+static void clearRegisterShadows(ShadowValue** registers){
+  for(int i = 0; i < MAX_REGISTERS; ++i){
+    if (registers[i] != NULL){
+      disownShadowValue(registers[i]);
+      registers[i] = NULL;
+    }
+  }
+}
+
+// Drop the register shadows of a thread that's going away, so that a
+// new thread which reuses its id starts out clean. Its freelists are
+// left alone, and get picked up by whoever reuses the id.
+void exitShadowThread(ThreadId tid){
+  if (tid >= numThreadStates || threadStates[tid] == NULL) return;
+  clearRegisterShadows(threadStates[tid]->registers);
+}
+
+void clearShadowThreadStates(void){
+  for(UInt tid = 0; tid < numThreadStates; ++tid){
+    if (threadStates[tid] != NULL){
+      clearRegisterShadows(threadStates[tid]->registers);
+    }
+  }
+}
 
 void initValueShadowState(void){
   for(int i = 0; i < MAX_TEMP_BLOCKS; ++i){
     freedTemps[i] = mkStack();
   }
+  tempArena = VG_(malloc)("shadow temp arena",
+                          TEMP_ARENA_SLOTS * sizeof(ArenaTempSlot));
+  VG_(memset)(tempArena, 0, TEMP_ARENA_SLOTS * sizeof(ArenaTempSlot));
+  for(int i = 0; i < TEMP_ARENA_SLOTS; ++i){
+    tempArena[i].temp.values = tempArena[i].values;
+  }
+  tempArenaNext = tempArena;
   freedVals = mkStack();
   tableEntries = mkStack();
+  misalignedMemShadows = VG_(HT_construct)("misaligned memory shadows");
   valueCacheSingle = VG_(HT_construct)("value cache single-precision");
   valueCacheDouble = VG_(HT_construct)("value cache double precision");
   initExprAllocator();
+  initReals();
+  // Valgrind's first thread is always 1; until the scheduler tells us
+  // otherwise, that's the one we're running.
+  switchShadowThread(1);
 }
 
 VG_REGPARM(2) void dynamicCleanup(int nentries, IRTemp* entries){
@@ -101,17 +198,20 @@ VG_REGPARM(2) void dynamicCleanup(int nentries, IRTemp* entries){
                       temp, j, entries[i]);
         }
       }
-      disownShadowValue(temp->values[j]);
+      if (!(temp->borrowed & (1UL << j))){
+        disownShadowValue(temp->values[j]);
+      }
       temp->values[j] = NULL;
     }
     freeShadowTemp(temp);
     shadowTemps[entries[i]] = NULL;
   }
+  tempArenaNext = tempArena;
   blockStateDirty = 0;
 }
 inline
 ShadowValue* getTS(Int idx){
-  ShadowValue* result = shadowThreadState[VG_(get_running_tid)()][idx];
+  ShadowValue* result = shadowThreadState[idx];
   tl_assert2(result == NULL || result->ref_count > 0,
              "Freed value %p left over at TS(%d)",
              result, idx);
@@ -147,51 +247,130 @@ VG_REGPARM(2) ShadowTemp* dynamicLoad(Addr memSrc, FloatBlocks numBlocks){
     return NULL;
   }
 }
-VG_REGPARM(1) ShadowValue* getMemShadow(Addr64 addr){
-  int key = addr % LARGE_PRIME;
-  for(TableValueEntry* node = shadowMemTable[key];
-      node != NULL; node = node->next){
-    if (node->addr == addr){
-      return node->val;
+// Find the secondary page covering addr, or NULL if nothing in that
+// page has ever been shadowed.
+static inline ShadowMemPage* getMemPage(Addr64 addr){
+  UWord base = SM_PAGE_BASE(addr);
+  for(ShadowMemPage* page = shadowMemPrimary[SM_PRIMARY_IDX(addr)];
+      page != NULL; page = page->next){
+    if (page->base == base){
+      return page;
     }
   }
   return NULL;
 }
+static ShadowMemPage* getOrMakeMemPage(Addr64 addr){
+  ShadowMemPage* page = getMemPage(addr);
+  if (page == NULL){
+    page = VG_(calloc)("shadow memory page", 1, sizeof(ShadowMemPage));
+    page->base = SM_PAGE_BASE(addr);
+    // Put new pages at the front of the chain, since the instrumented
+    // fast path only ever looks at the first one.
+    page->next = shadowMemPrimary[SM_PRIMARY_IDX(addr)];
+    shadowMemPrimary[SM_PRIMARY_IDX(addr)] = page;
+    if (print_allocs){
+      VG_(printf)("Making shadow memory page %p for %lX\n",
+                  page, page->base);
+    }
+  }
+  return page;
+}
+VG_REGPARM(1) ShadowValue* getMemShadow(Addr64 addr){
+  if (!SM_IS_ALIGNED(addr)){
+    MisalignedShadowEntry* entry =
+      VG_(HT_lookup)(misalignedMemShadows, addr);
+    return entry == NULL ? NULL : entry->val;
+  }
+  ShadowMemPage* page = getMemPage(addr);
+  if (page == NULL){
+    return NULL;
+  }
+  return page->vals[SM_SLOT_IDX(addr)];
+}
 VG_REGPARM(3) void setMemShadowTemp(Addr64 memDest,
                                     UWord size,
                                     ShadowTemp* st){
   for(int i = 0; i < size; ++i){
     UWord addr = memDest + i * sizeof(float);
-    removeMemShadow(addr);
     if (st != NULL && st->values[i] != NULL){
       addMemShadow(addr, st->values[i]);
+    } else {
+      removeMemShadow(addr);
     }
   }
 }
 void removeMemShadow(Addr64 addr){
-  int key = addr % LARGE_PRIME;
-  TableValueEntry* prevEntry = NULL;
-  for(TableValueEntry* node = shadowMemTable[key];
-      node != NULL; node = node->next){
-    if (node->addr == addr){
-      if (prevEntry == NULL){
-        shadowMemTable[key] = node->next;
-      } else {
-        prevEntry->next = node->next;
+  if (!SM_IS_ALIGNED(addr)){
+    MisalignedShadowEntry* entry =
+      VG_(HT_remove)(misalignedMemShadows, addr);
+    if (entry == NULL) return;
+    if (PRINT_VALUE_MOVES){
+      VG_(printf)("Clearing %llX, which disowns %p (old rc %lu)\n",
+                  addr, entry->val, entry->val->ref_count);
+    }
+    disownShadowValue(entry->val);
+    VG_(free)(entry);
+    return;
+  }
+  ShadowMemPage* page = getMemPage(addr);
+  if (page == NULL) return;
+  ShadowValue** slot = &(page->vals[SM_SLOT_IDX(addr)]);
+  if (*slot == NULL) return;
+  if (PRINT_VALUE_MOVES){
+    VG_(printf)("Clearing %llX, which disowns %p (old rc %lu)\n",
+                addr, *slot, (*slot)->ref_count);
+  }
+  disownShadowValue(*slot);
+  *slot = NULL;
+  page->num_live--;
+}
+// Clear every shadow in [start, start + len), and give back any pages
+// that end up empty. This is what gets called when client memory goes
+// away wholesale, so it works a page at a time instead of a word at a
+// time.
+void clearMemShadowRange(Addr64 start, SizeT len){
+  Addr64 end = start + len;
+  if (VG_(HT_count_nodes)(misalignedMemShadows) > 0){
+    UInt numEntries;
+    VgHashNode** entries =
+      VG_(HT_to_array)(misalignedMemShadows, &numEntries);
+    for(UInt i = 0; i < numEntries; ++i){
+      MisalignedShadowEntry* entry = (MisalignedShadowEntry*)entries[i];
+      if (entry->addr >= start && entry->addr < end){
+        removeMemShadow(entry->addr);
       }
-
-      if (PRINT_VALUE_MOVES){
-        VG_(printf)("Clearing %llX", addr);
-        if (node->val != NULL){
-          VG_(printf)(", which disowns %p (old rc %lu)", node->val, node->val->ref_count);
+    }
+    VG_(free)(entries);
+  }
+  Addr64 pageBase = SM_PAGE_BASE(start);
+  while(pageBase < end){
+    Addr64 nextPageBase = pageBase + SM_PAGE_SIZE;
+    ShadowMemPage** link = &(shadowMemPrimary[SM_PRIMARY_IDX(pageBase)]);
+    while(*link != NULL && (*link)->base != pageBase){
+      link = &((*link)->next);
+    }
+    ShadowMemPage* page = *link;
+    if (page != NULL){
+      Addr64 clearStart = start > pageBase ? start : pageBase;
+      Addr64 clearEnd = end < nextPageBase ? end : nextPageBase;
+      for(UWord i = SM_SLOT_IDX(clearStart);
+          i < SM_SLOTS_PER_PAGE && page->num_live > 0 &&
+            pageBase + (i << SM_SLOT_BITS) < clearEnd;
+          ++i){
+        if (page->vals[i] != NULL){
+          disownShadowValue(page->vals[i]);
+          page->vals[i] = NULL;
+          page->num_live--;
         }
-        VG_(printf)("\n");
       }
-      disownShadowValue(node->val);
-      stack_push(tableEntries, (void*)node);
-      break;
+      if (page->num_live == 0){
+        *link = page->next;
+        VG_(free)(page);
+      }
     }
-    prevEntry = node;
+    // Watch out for wrapping around the top of the address space.
+    if (nextPageBase < pageBase) break;
+    pageBase = nextPageBase;
   }
 }
 
@@ -205,41 +384,70 @@ VG_REGPARM(1) ShadowValue* toDouble(ShadowValue* val){
   result->type = Vt_Double;
   return result;
 }
-VG_REGPARM(0) TableValueEntry* newTableValueEntry(void){
-  return VG_(malloc)("tableEntry", sizeof(TableValueEntry));
-}
-inline TableValueEntry* mkTableEntry(void){
-  TableValueEntry* newEntry;
+inline ValueCacheEntry* mkTableEntry(void){
+  ValueCacheEntry* newEntry;
   if (stack_empty(tableEntries)){
-    newEntry = VG_(malloc)("tableEntry", sizeof(TableValueEntry));
+    newEntry = VG_(malloc)("tableEntry", sizeof(ValueCacheEntry));
   } else {
     newEntry = (void*)stack_pop(tableEntries);
   }
   return newEntry;
 }
 void addMemShadow(Addr64 addr, ShadowValue* val){
-  TableValueEntry* newEntry = mkTableEntry();
-  newEntry->addr = addr;
-  newEntry->val = val;
+  if (val == NULL) return;
+  if (!SM_IS_ALIGNED(addr)){
+    MisalignedShadowEntry* entry =
+      VG_(HT_lookup)(misalignedMemShadows, addr);
+    ownShadowValue(val);
+    if (entry == NULL){
+      entry = VG_(malloc)("misaligned shadow entry",
+                          sizeof(MisalignedShadowEntry));
+      entry->addr = addr;
+      entry->val = val;
+      VG_(HT_add_node)(misalignedMemShadows, entry);
+    } else {
+      disownShadowValue(entry->val);
+      entry->val = val;
+    }
+    if (PRINT_VALUE_MOVES){
+      VG_(printf)("Setting %llX to %p (new rc %lu)\n",
+                  addr, val, val->ref_count);
+    }
+    return;
+  }
+  ShadowMemPage* page = getOrMakeMemPage(addr);
+  ShadowValue** slot = &(page->vals[SM_SLOT_IDX(addr)]);
+  // Own before disowning, in case we're overwriting a value with
+  // itself.
   ownShadowValue(val);
-
-  int key = addr % LARGE_PRIME;
-  newEntry->next = shadowMemTable[key];
-  shadowMemTable[key] = newEntry;
+  if (*slot == NULL){
+    page->num_live++;
+  } else {
+    disownShadowValue(*slot);
+  }
+  *slot = val;
   if (PRINT_VALUE_MOVES){
-    VG_(printf)("Setting %llX to %p", addr, val);
-    if (val != NULL){
-      VG_(printf)(" (new rc %lu)", val->ref_count);
-    }
-    VG_(printf)("\n");
+    VG_(printf)("Setting %llX to %p (new rc %lu)\n",
+                addr, val, val->ref_count);
   }
 }
 void freeShadowTemp(ShadowTemp* temp){
+  if (IN_TEMP_ARENA(temp)) return;
   stack_push(freedTemps[INT(temp->num_blocks) - 1], (void*)temp);
 }
 
 inline
 ShadowTemp* mkShadowTemp(FloatBlocks num_blocks){
+  if (tempArenaNext < tempArena + TEMP_ARENA_SLOTS){
+    ShadowTemp* result = &(tempArenaNext->temp);
+    result->num_blocks = num_blocks;
+    result->borrowed = 0;
+    tempArenaNext++;
+    return result;
+  }
+  return mkShadowTempOffArena(num_blocks);
+}
+VG_REGPARM(1) ShadowTemp* mkShadowTempOffArena(FloatBlocks num_blocks){
   ShadowTemp* result;
   if (stack_empty(freedTemps[INT(num_blocks) - 1])){
     result = newShadowTemp(num_blocks);
@@ -249,6 +457,7 @@ ShadowTemp* mkShadowTemp(FloatBlocks num_blocks){
     }
   } else {
     result = (void*)stack_pop(freedTemps[INT(num_blocks) - 1]);
+    result->borrowed = 0;
   }
   return result;
 }
@@ -256,10 +465,8 @@ void freeShadowValue(ShadowValue* val){
   if (PRINT_VALUE_MOVES){
     VG_(printf)("Disowned last reference to %p! Freeing...\n", val);
   }
-  if (val->influences != NULL){
-    freeInfluenceList(val->influences);
-    val->influences = NULL;
-  }
+  disownInfluenceList(val->influences);
+  val->influences = NULL;
   if (!no_exprs){
     if (print_expr_refs){
       VG_(printf)("Disowning expression %p as part of freeing val %p\n",
@@ -267,15 +474,16 @@ void freeShadowValue(ShadowValue* val){
     }
     disownConcExpr(val->expr);
   }
-  double value = getDouble(val->real);
+  double value = getValDouble(val);
   if (value == 0.0) value = 0.0;
   if (isNaN(val->real)) value = NAN;
-  TableValueEntry* entry =
+  ValueCacheEntry* entry =
     VG_(HT_remove)(val->type == Vt_Single ? valueCacheSingle : valueCacheDouble,
                    *(UWord*)&value);
   if (entry != NULL){
     stack_push(tableEntries, (void*)entry);
   }
+  liveShadowValues--;
   stack_push_fast(freedVals, (void*)val);
 }
 
@@ -283,11 +491,12 @@ ShadowValue* copyShadowValue(ShadowValue* val){
   ShadowValue* copy = mkShadowValueBare(val->type);
   if (!no_reals){
     copyReal(val->real, copy->real);
+    copy->rounded_state = val->rounded_state;
+    copy->rounded = val->rounded;
   }
   copy->expr = val->expr;
   if (!no_exprs){
-    recursivelyOwnConcExpr(copy->expr,
-                           max_expr_block_depth * 2);
+    ownConcExpr(copy->expr);
   }
   if (!no_influences){
     copy->influences = cloneInfluences(val->influences);
@@ -312,9 +521,32 @@ ShadowValue* mkShadowValueBare(ValueType type){
     result->type = type;
   }
   result->ref_count = 1;
+  result->rounded_state = Rs_Stale;
+  liveShadowValues++;
   return result;
 }
 
+// Make several bare values at once, for the lanes of a SIMD op.
+void mkShadowValuesBare(ValueType type, int count, ShadowValue** out){
+  tl_assert2(type == Vt_Single || type == Vt_Double,
+             "Invalid type! %s\n", typeName(type));
+  int i = 0;
+  for(; i < count && !stack_empty_fast(freedVals); ++i){
+    out[i] = (void*)stack_pop_fast(freedVals);
+    tl_assert2(out[i]->ref_count == 0,
+               "Shadow value %p just popped off the stack has a ref count of %d!\n",
+               out[i], out[i]->ref_count);
+    out[i]->type = type;
+    out[i]->ref_count = 1;
+    out[i]->rounded_state = Rs_Stale;
+  }
+  for(; i < count; ++i){
+    out[i] = newShadowValue(type);
+    out[i]->rounded_state = Rs_Stale;
+  }
+  liveShadowValues += count;
+}
+
 VG_REGPARM(2) ShadowValue* mkShadowValue_wrapper(ValueType type, UWord value){
   return mkShadowValue(type, *(double*)(void*)&value);
 }
@@ -325,7 +557,7 @@ ShadowValue* mkShadowValue(ValueType type, double value){
   if (value == 0.0) value = 0.0;
   if (value != value) value = NAN;
   UWord key = *(UWord*)&value;
-  TableValueEntry* existingEntry =
+  ValueCacheEntry* existingEntry =
     VG_(HT_lookup)(type == Vt_Single ? valueCacheSingle : valueCacheDouble, key);
   ShadowValue* result = NULL;
   if (existingEntry == NULL || no_reals){
@@ -337,6 +569,8 @@ ShadowValue* mkShadowValue(ValueType type, double value){
         VG_(printf)("\n");
       }
       setReal(result->real, value);
+      result->rounded = value;
+      result->rounded_state = Rs_Exact;
 
       ValueCacheEntry* newEntry = (void*)mkTableEntry();
       newEntry->val = result;
@@ -397,7 +631,9 @@ void disownShadowTemp(ShadowTemp* temp){
                     temp->values[i], temp->values[i]->ref_count, temp);
       }
     }
-    disownShadowValue(temp->values[i]);
+    if (!(temp->borrowed & (1UL << i))){
+      disownShadowValue(temp->values[i]);
+    }
     temp->values[i] = NULL;
   }
   freeShadowTemp(temp);
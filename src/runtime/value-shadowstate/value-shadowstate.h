@@ -37,12 +37,24 @@
 // * Values that persist between blocks (I think this is how it
 //   works), are held in a per thread data structure by VEX, so we set
 //   up another array for every thread to hold those, also up to a
-//   limit set in the .h file.
+//   limit set in the .h file. The table of these grows as threads
+//   show up, and shadowThreadState always points at the running
+//   thread's array, so instrumentation has to load it at run time
+//   rather than baking in whichever thread was translating.
+//
+//   Valgrind only switches threads between blocks, so the temps and
+//   the computed arg/result scratch space, which only live within a
+//   block, are shared by all threads. The freelists are swapped out
+//   per thread on each switch.
 //
 // * Finally, values might be written to memory, and then read out
-//   later at some arbitrary point. For these, we'll maintain a hash
-//   table that maps addresses to shadow values, so we don't have to
-//   maintain a vast array of shadow values for all of memory.
+//   later at some arbitrary point. For these, we'll maintain a
+//   two-level map, like memcheck's: a primary map indexed by the high
+//   bits of the address points to lazily allocated secondary pages,
+//   each of which holds a shadow value slot for every 4-byte word in
+//   a 64KiB chunk of memory. That way the common case is two loads
+//   and no division, and we don't have to maintain a vast array of
+//   shadow values for all of memory.
 
 #ifndef _VALUE_SHADOWSTATE_H
 #define _VALUE_SHADOWSTATE_H
@@ -55,15 +67,49 @@
 
 #include "../../helper/stack.h"
 
-#define MAX_THREADS 16
+// Each secondary page covers 2^SM_PAGE_BITS bytes of client memory,
+// with one slot per float-sized word. Floats that aren't aligned to
+// a word don't fit in those slots, so they're kept out of the pages
+// entirely; see misalignedMemShadows.
+#define SM_PAGE_BITS 16
+#define SM_PAGE_SIZE (1UL << SM_PAGE_BITS)
+#define SM_PAGE_MASK (SM_PAGE_SIZE - 1)
+#define SM_SLOT_BITS 2
+#define SM_SLOTS_PER_PAGE (SM_PAGE_SIZE >> SM_SLOT_BITS)
+// The primary map is indexed by the SM_PRIMARY_BITS address bits just
+// above the page bits, so it directly covers 2^(SM_PRIMARY_BITS +
+// SM_PAGE_BITS) bytes (64GB) before two pages land in the same
+// primary entry. Pages which do collide get chained off the entry,
+// and the inline fast path bails out to C when the first page in the
+// chain isn't the right one.
+#define SM_PRIMARY_BITS 20
+#define SM_PRIMARY_SIZE (1UL << SM_PRIMARY_BITS)
+#define SM_PRIMARY_MASK (SM_PRIMARY_SIZE - 1)
+
+#define SM_PRIMARY_IDX(addr) (((addr) >> SM_PAGE_BITS) & SM_PRIMARY_MASK)
+#define SM_PAGE_BASE(addr) ((addr) & ~SM_PAGE_MASK)
+#define SM_SLOT_IDX(addr) (((addr) & SM_PAGE_MASK) >> SM_SLOT_BITS)
+#define SM_MISALIGNMENT_MASK ((1UL << SM_SLOT_BITS) - 1)
+#define SM_IS_ALIGNED(addr) (((addr) & SM_MISALIGNMENT_MASK) == 0)
 
-#define LARGE_PRIME 1572869
+typedef struct _shadowMemPage {
+  // Other pages which map to the same primary entry.
+  struct _shadowMemPage* next;
+  // The address of the first byte of client memory this page covers.
+  UWord base;
+  // How many of the slots below are non-NULL.
+  UWord num_live;
+  ShadowValue* vals[SM_SLOTS_PER_PAGE];
+} ShadowMemPage;
 
-typedef struct _tableValueEntry {
-  struct _tableValueEntry* next;
+// Shadows of floats at misaligned addresses, keyed on their exact
+// address. Those are rare, so they always go through C, and the
+// inline lookups bail out to it for any misaligned address.
+typedef struct _misalignedShadowEntry {
+  struct _misalignedShadowEntry* next;
   UWord addr;
   ShadowValue* val;
-} TableValueEntry;
+} MisalignedShadowEntry;
 
 typedef struct _valueCacheEntry {
   struct _valueCacheEntry* next;
@@ -81,16 +127,37 @@ typedef union {
   double d[4];
 } ResultUnion;
 
+// Shadow temps never outlive the superblock that makes them, so they
+// get bumped off an arena that's reset every time a block exits,
+// instead of going through the freelists one at a time. Each slot
+// has room for the widest temp, with its values array already
+// pointing just past it. Only when a block makes more temps than the
+// arena holds do the rest come from freedTemps, the old way.
+#define TEMP_ARENA_SLOTS 4096
+typedef struct _ArenaTempSlot {
+  ShadowTemp temp;
+  ShadowValue* values[MAX_TEMP_BLOCKS];
+} ArenaTempSlot;
+#define IN_TEMP_ARENA(t)                                        \
+  ((UWord)((char*)(t) - (char*)tempArena) <                     \
+   TEMP_ARENA_SLOTS * sizeof(ArenaTempSlot))
+
 extern ArgUnion computedArgs;
 
 extern ResultUnion computedResult;
 
 extern ShadowTemp* shadowTemps[MAX_TEMPS];
-extern ShadowValue* shadowThreadState[MAX_THREADS][MAX_REGISTERS];
-extern TableValueEntry* shadowMemTable[LARGE_PRIME];
+extern ShadowValue** shadowThreadState;
+extern ShadowMemPage* shadowMemPrimary[SM_PRIMARY_SIZE];
+extern VgHashTable* misalignedMemShadows;
 
 extern Stack* freedTemps[MAX_TEMP_BLOCKS];
+extern ArenaTempSlot* tempArena;
+extern ArenaTempSlot* tempArenaNext;
 extern Stack* freedVals;
+// How many shadow values are currently allocated and not freed. While
+// this is zero no temp, register, or memory location is shadowed.
+extern ULong liveShadowValues;
 extern Stack* tableEntries;
 extern VgHashTable* valueCacheSingle;
 extern VgHashTable* valueCacheDouble;
@@ -103,6 +170,9 @@ extern Word256 getBytes;
 extern int blockStateDirty;
 
 void initValueShadowState(void);
+void switchShadowThread(ThreadId tid);
+void exitShadowThread(ThreadId tid);
+void clearShadowThreadStates(void);
 VG_REGPARM(2) void dynamicCleanup(int nentries, IRTemp* entries);
 VG_REGPARM(2) void dynamicPut(Int tsDest, ShadowTemp* st);
 VG_REGPARM(2) ShadowTemp* dynamicGet64(Int tsSrc,
@@ -111,12 +181,12 @@ VG_REGPARM(3) ShadowTemp* dynamicGet128(Int tsSrc, UWord bytes1, UWord bytes2);
 VG_REGPARM(2) ShadowTemp* dynamicGet256(Int tsSrc, Word256* bytes);
 ShadowTemp* dynamicGet(Int tsSrc, void* bytes, int size);
 VG_REGPARM(2) ShadowTemp* dynamicLoad(Addr memSrc, FloatBlocks size);
-VG_REGPARM(0) TableValueEntry* newTableValueEntry(void);
 VG_REGPARM(3) void setMemShadowTemp(Addr64 memDest, UWord size,
                                     ShadowTemp* st);
 VG_REGPARM(1) ShadowValue* getMemShadow(Addr64 memSrc);
 void removeMemShadow(Addr64 addr);
 void addMemShadow(Addr64 addr, ShadowValue* val);
+void clearMemShadowRange(Addr64 start, SizeT len);
 
 VG_REGPARM(1) void disownShadowTempNonNull(ShadowTemp* temp);
 VG_REGPARM(1) void disownShadowTemp(ShadowTemp* temp);
@@ -126,6 +196,7 @@ VG_REGPARM(1) ShadowValue* toSingle(ShadowValue* v);
 VG_REGPARM(1) ShadowValue* toDouble(ShadowValue* v);
 
 ShadowTemp* mkShadowTemp(FloatBlocks num_blocks);
+VG_REGPARM(1) ShadowTemp* mkShadowTempOffArena(FloatBlocks num_blocks);
 void freeShadowTemp(ShadowTemp* temp);
 void disownShadowTemp(ShadowTemp* temp);
 VG_REGPARM(1) void disownShadowTempNonNullDynamic(IRTemp idx);
@@ -135,6 +206,7 @@ void ownShadowValue(ShadowValue* val);
 void freeShadowValue(ShadowValue* val);
 ShadowValue* copyShadowValue(ShadowValue* val);
 ShadowValue* mkShadowValueBare(ValueType type);
+void mkShadowValuesBare(ValueType type, int count, ShadowValue** out);
 ShadowValue* mkShadowValue(ValueType type, double value);
 VG_REGPARM(2) ShadowValue* mkShadowValue_wrapper(ValueType type, UWord value);
 
@@ -168,6 +240,8 @@ ShadowValue* mkShadowValueBare_fast(ValueType type){
     result->type = type;
   }
   result->ref_count = 1;
+  result->rounded_state = Rs_Stale;
+  liveShadowValues++;
   return result;
 }
 __attribute__((always_inline))
@@ -175,16 +249,20 @@ inline
 ShadowValue* mkShadowValue_fast(ValueType type, double value){
   ShadowValue* result = mkShadowValueBare(type);
   setReal_fast(result->real, value);
+  result->rounded = value;
+  result->rounded_state = Rs_Exact;
   return result;
 }
 __attribute__((always_inline))
 inline
 void freeShadowValue_fast(ShadowValue* val){
+  liveShadowValues--;
   stack_push_fast(freedVals, (void*)val);
 }
 __attribute__((always_inline))
 inline
 void freeShadowTemp_fast(ShadowTemp* temp){
+  if (IN_TEMP_ARENA(temp)) return;
   stack_push_fast(freedTemps[INT(temp->num_blocks)- 1], (void*)temp);
 }
 __attribute__((always_inline))
@@ -204,7 +282,9 @@ __attribute__((always_inline))
 inline
 void disownShadowTemp_fast(ShadowTemp* temp){
   for(int i = 0; i < INT(temp->num_blocks); ++i){
-    disownShadowValue(temp->values[i]);
+    if (!(temp->borrowed & (1UL << i))){
+      disownShadowValue(temp->values[i]);
+    }
   }
   freeShadowTemp_fast(temp);
 }